@@ -157,6 +157,7 @@ template <>
 struct Traits<Synchronizer> : public Traits<Build>
 {
     static const bool enabled = Traits<System>::multithread;
+    static const unsigned int SPIN_LIMIT = 20; // us a contended Mutex spins while its owner runs on another core (0 => always sleep)
     static const bool INHERITANCE = false;
     static const bool CEILING_PROTOCOL = true;
 };
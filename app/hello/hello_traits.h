@@ -135,6 +135,7 @@ template<> struct Traits<Scheduler<Thread>>: public Traits<Build>
 template<> struct Traits<Synchronizer>: public Traits<Build>
 {
     static const bool enabled = Traits<System>::multithread;
+    static const unsigned int SPIN_LIMIT = 20; // us a contended Mutex spins while its owner runs on another core (0 => always sleep)
 };
 
 template<> struct Traits<Alarm>: public Traits<Build>
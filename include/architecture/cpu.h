@@ -167,30 +167,74 @@ public:
         return old;
     }
 
-    template <int (*finc)(volatile int &)>
-    static void smp_barrier(unsigned int cores, unsigned int id)
+    static void fence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+    // Sense-reversing combining tree barrier
+    // Participant i waits for its children (2i+1 and 2i+2) to arrive, reports to its
+    // parent ((i-1)/2) and then waits for the parent to release it. Every flag has a
+    // single writer and each participant only spins on flags in its own node, which
+    // sits on a cache line of its own, so there is no shared counter to bounce around.
+    // Flags are never cleared: each episode waits for the opposite value of the
+    // previous one. The all-zero state is valid, so barriers with static storage
+    // need no run-time initialization. Participants are numbered 0..n-1 and every
+    // episode must involve the same n of them.
+    class SMP_Barrier
     {
-        if (cores > 1)
-        {
-            static volatile int ready[2];
-            static volatile int i;
+    private:
+        static const unsigned int MAX = Traits<Build>::CPUS;
+        static const unsigned int CACHE_LINE = 64;
 
-            int j = i;
+        struct Node
+        {
+            volatile bool arrived[2]; // written by the children
+            volatile bool release;    // written by the parent
+            bool sense;               // last episode's value, private to the owner
+        } __attribute__((aligned(CACHE_LINE)));
 
-            finc(ready[j]);
-            if (id == 1)
-            {
-                while (ready[j] < int(cores))
-                    ;         // wait for all CPUs to be ready
-                i = !i;       // toggle ready
-                ready[j] = 0; // signalizes waiting CPUs
-            }
-            else
+    public:
+        void wait(unsigned int id, unsigned int n = MAX)
+        {
+            if (n <= 1)
+                return;
+
+            Node &me = _node[id];
+            bool sense = !me.sense;
+            unsigned int left = 2 * id + 1;
+            unsigned int right = left + 1;
+
+            if (left < n)
+                while (me.arrived[0] != sense)
+                    ;
+            if (right < n)
+                while (me.arrived[1] != sense)
+                    ;
+            fence();
+
+            if (id != 0)
             {
-                while (ready[j])
-                    ; // wait for CPU[0] signal
+                _node[(id - 1) / 2].arrived[(id - 1) & 1] = sense;
+                while (me.release != sense)
+                    ;
+                fence();
             }
+
+            if (left < n)
+                _node[left].release = sense;
+            if (right < n)
+                _node[right].release = sense;
+
+            me.sense = sense;
         }
+
+    private:
+        Node _node[MAX];
+    };
+
+    static void smp_barrier(unsigned int cores, unsigned int id)
+    {
+        static SMP_Barrier barrier;
+
+        barrier.wait(id, cores);
     }
 
     static void fpu_save();
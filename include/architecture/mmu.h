@@ -9,6 +9,49 @@
 
 __BEGIN_SYS
 
+// Set of page colors (bit n for COLOR_n). Memory allocated for a set is spread over its colors
+// round-robin, so giving each hard real-time thread a disjoint set partitions the shared cache.
+// The default set is empty, meaning no color was asked for: such memory is not colored and comes
+// from WHITE. It is distinct from {COLOR_0}, although WHITE == COLOR_0, so COLOR_0 can be asked for too.
+class Color_Set
+{
+public:
+    Color_Set(): _colors(0) {}
+    Color_Set(Color c): _colors(1UL << c) {}
+    Color_Set(Color first, Color last): _colors(0) { for(unsigned int c = first; c <= last; c++) _colors |= 1UL << c; }
+
+    void add(Color c) { _colors |= 1UL << c; }
+    void remove(Color c) { _colors &= ~(1UL << c); }
+    bool contains(Color c) const { return _colors & (1UL << c); }
+    bool empty() const { return !_colors; }
+
+    unsigned int count() const {
+        unsigned int n = 0;
+        for(unsigned long c = _colors; c; c &= c - 1)
+            n++;
+        return n;
+    }
+
+    // The i-th color of the set, wrapping around
+    Color operator[](unsigned long i) const {
+        unsigned int n = count();
+        if(!n)
+            return WHITE;
+        i %= n;
+        for(unsigned int c = 0; ; c++)
+            if((_colors & (1UL << c)) && !i--)
+                return Color(c);
+    }
+
+    bool operator==(const Color_Set & s) const { return _colors == s._colors; }
+    bool operator!=(const Color_Set & s) const { return _colors != s._colors; }
+
+    friend OStream & operator<<(OStream & os, const Color_Set & s) { os << hex << s._colors << dec; return os; }
+
+private:
+    unsigned long _colors;
+};
+
 // This common package provides operations to implement MMUs assuming a design with the following elements:
 // * A Page_Directory (PD), which is the higher level of the paging hierarchy, associated to an Address_Space via a Directory;
 // * A viable size Page_Table (PT), which is the lower level of the paging hierarchy, associated with a Segment via a Chunk;
@@ -70,6 +113,8 @@ public:
             IO   = 1 << 11, // Memory Mapped I/O (0=memory, 1=I/O)
             CT   = 1 << 12, // Contiguous (0=non-contiguous, 1=contiguous)
             SPE  = 1 << 13,
+            LZ   = 1 << 14, // Lazy (frames are allocated and zeroed on first touch)
+            FX   = 1 << 15, // Fixed (flags and size never change, so the mapping may use large pages)
             SYSC = (PRE | RD | EX),
             SYSD = (PRE | RD | WR),
             APPC = (PRE | RD | EX | USR),
@@ -101,6 +146,9 @@ public:
         Reg _flags;
     };
 
+    // Page colors
+    typedef EPOS::S::Color_Set Color_Set;
+
     // Page types
     enum Page_Type {PG, PT, AT, PD};
 
@@ -126,6 +174,9 @@ public:
     constexpr static Log_Addr align_segment(Log_Addr addr) { return (addr + PT_ENTRIES * sizeof(Page) - 1) &  ~(PT_ENTRIES * sizeof(Page) - 1); }
 
     constexpr static Log_Addr directory_bits(Log_Addr addr) { return (addr & ~((1 << PD_BITS) - 1)); }
+
+    // Background work for the idle thread (e.g. zeroing frames ahead of calloc()); MMUs that have none inherit this
+    static void prezero() {}
 };
 
 class No_MMU: public MMU_Common<0, 0, 0>
@@ -154,7 +205,8 @@ public:
     public:
         Chunk() {}
         Chunk(const Chunk & c): _free(false), _phy_addr(c._phy_addr), _bytes(c._bytes), _flags(c._flags) {} // avoid freeing memory when temporaries are created
-        Chunk(unsigned long bytes, Flags flags, Color color = WHITE): _free(true), _phy_addr(alloc(bytes)), _bytes(bytes), _flags(flags) {}
+        Chunk(unsigned long bytes, Flags flags, const Color_Set & colors = WHITE): _free(true), _phy_addr((flags & Flags::LZ) ? calloc(bytes) : alloc(bytes)), _bytes(bytes), _flags(flags) {} // no paging, so LZ only means zeroed
+        Chunk(const Chunk & c, bool copy_on_write): _free(true), _phy_addr(alloc(c._bytes)), _bytes(c._bytes), _flags(c._flags) { memcpy(_phy_addr, c._phy_addr, _bytes); } // no paging, so always copied
         Chunk(Phy_Addr phy_addr, unsigned long bytes, Flags flags):  _free(false), _phy_addr(phy_addr), _bytes(bytes), _flags(flags) {}
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags):_free(false), _phy_addr(0), _bytes(to - from), _flags(flags) {}
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags, Phy_Addr phy_addr): _free(false), _phy_addr(phy_addr), _bytes(to - from), _flags(flags) {}
@@ -198,6 +250,9 @@ public:
         Phy_Addr physical(Log_Addr addr) { return addr; }
     };
 
+    // Page faults never come from lazy chunks without paging
+    static bool fault(Log_Addr addr, bool write) { return false; }
+
     // DMA_Buffer (straightforward without paging)
     class DMA_Buffer: public Chunk
     {
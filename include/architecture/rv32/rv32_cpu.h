@@ -24,6 +24,7 @@ public:
     using CPU_Common::Log_Addr;
     using CPU_Common::Phy_Addr;
     using CPU_Common::Interrupt_Id;
+    using CPU_Common::SMP_Barrier;
 
     // Status Register ([m|s]status)
     typedef Reg Status;
@@ -61,6 +62,11 @@ public:
         SD              = 1UL << 31     // Status Dirty = (FS | XS)
     };
 
+    // MENVCFGH (the upper half of menvcfg on RV32)
+    enum : Reg {
+        STCE            = 1UL << 31     // Sstc: supervisor timer compare (stimecmp) Enabled
+    };
+
     // [M|S]TVEC modes
     enum : Reg {
         INT_DIRECT  = 0,
@@ -164,6 +170,11 @@ public:
         static void pop(bool interrupt = false);  // interrupt or context switch?
         static void push(bool interrupt = false); // interrupt or context switch?
 
+        // Lean interrupt frame (PC, ST, RA, T0-T6 and A0-A7) for handlers that are plain functions: the ABI makes
+        // them preserve the callee-saved registers, and switch_context() saves those if the handler reschedules
+        static void pop_lean();
+        static void push_lean();
+
     private:
         Reg _pc;      // pc
         Reg _st;      // [m|s]status
@@ -227,7 +238,7 @@ public:
     static unsigned int id() { return supervisor ? tp() : mhartid(); }
     static unsigned int cores() { return 1; }
 
-    static void smp_barrier(unsigned long cores = CPU::cores()) { CPU_Common::smp_barrier<&finc>(cores, CPU::id()); }
+    static void smp_barrier(unsigned long cores = CPU::cores()) { CPU_Common::smp_barrier(cores, CPU::id()); }
 
 
     using CPU_Common::clock;
@@ -288,6 +299,8 @@ public:
         return old;
     }
 
+    using CPU_Common::fence;
+
     static void flush_tlb() {         ASM("sfence.vma"    : :           : "memory"); }
     static void flush_tlb(Reg addr) { ASM("sfence.vma %0" : : "r"(addr) : "memory"); }
 
@@ -400,6 +413,10 @@ public:
     static void pmpaddr0(Reg64 r)     { ASM("csrw pmpaddr0, %0" : : "r"(r) : "cc"); }
     static Reg64  pmpaddr0() { Reg64 r; ASM("csrr %0, pmpaddr0" :  "=r"(r) : : ); return r; }
 
+    // menvcfg[h] only exist from the 1.12 privileged spec on and older assemblers don't know them, hence the CSR numbers
+    static void menvcfgs(Reg r) { ASM("csrs 0x31a, %0" : : "r"(r) : "cc"); }
+    static Reg  menvcfg() { Reg r = 0; ASM("csrr %0, 0x31a" : "+r"(r) : : ); return r; } // left at 0 if the access traps and is skipped
+
     // Supervisor mode
     static void sint_enable()  { ASM("csrsi sstatus, %0" : : "i"(SIE) : "cc"); }
     static void sint_disable() { ASM("csrci sstatus, %0" : : "i"(SIE) : "cc"); }
@@ -436,6 +453,12 @@ public:
     static void satp(Reg r) { ASM("csrw satp, %0" : : "r"(r) : "cc"); ASM("sfence.vma" : : : "memory"); }
     static Reg  satp() { Reg r; ASM("csrr %0, satp" :  "=r"(r) : : ); return r; }
 
+    // Sstc timer compare, accessible only if machine mode set menvcfgh.STCE (see sstc()); the high half goes first so no spurious match happens in between
+    static void stimecmp(Reg64 v) { ASM("csrw 0x15d, %0" : : "r"(-1) : "cc"); ASM("csrw 0x14d, %0" : : "r"(Reg(v)) : "cc"); ASM("csrw 0x15d, %0" : : "r"(Reg(v >> 32)) : "cc"); }
+    static Reg64 stimecmp() { Reg l = 0, h = 0; ASM("csrr %0, 0x14d" : "+r"(l) : : ); ASM("csrr %0, 0x15d" : "+r"(h) : : ); return (Reg64(h) << 32) | l; }
+
+    static bool sstc();
+
 private:
     template<typename Head, typename ... Tail>
     static void init_stack_helper(Log_Addr sp, Head head, Tail ... tail) {
@@ -444,6 +467,8 @@ private:
     }
     static void init_stack_helper(Log_Addr sp) {}
 
+    static void skip() __attribute__((naked, aligned(4)));
+
     static void init();
 
 private:
@@ -550,6 +575,74 @@ if(supervisor) {
 }
 }
 
+inline void CPU::Context::push_lean()
+{
+    ASM("       addi     sp, sp, %0             \n" : : "i"(-80));   // 80 bytes keep SP 16-byte aligned
+if(supervisor) {
+    ASM("       csrr     x3,    sepc            \n");
+} else {
+    ASM("       csrr     x3,    mepc            \n");
+}
+    ASM("       sw       x3,    0(sp)           \n");   // push PC
+if(supervisor) {
+    ASM("       csrr     x3, sstatus            \n");
+} else {
+    ASM("       csrr     x3, mstatus            \n");
+}
+    ASM("       sw       x3,    4(sp)           \n"     // push ST
+        "       sw       x1,    8(sp)           \n"     // push RA
+        "       sw       x5,   12(sp)           \n"     // push T0-T2, A0-A7 and T3-T6
+        "       sw       x6,   16(sp)           \n"
+        "       sw       x7,   20(sp)           \n"
+        "       sw      x10,   24(sp)           \n"
+        "       sw      x11,   28(sp)           \n"
+        "       sw      x12,   32(sp)           \n"
+        "       sw      x13,   36(sp)           \n"
+        "       sw      x14,   40(sp)           \n"
+        "       sw      x15,   44(sp)           \n"
+        "       sw      x16,   48(sp)           \n"
+        "       sw      x17,   52(sp)           \n"
+        "       sw      x28,   56(sp)           \n"
+        "       sw      x29,   60(sp)           \n"
+        "       sw      x30,   64(sp)           \n"
+        "       sw      x31,   68(sp)           \n");
+}
+
+inline void CPU::Context::pop_lean()
+{
+    ASM("       lw       x3,    0(sp)           \n"); // pop PC into TMP
+if(supervisor) {
+    ASM("       csrw     sepc, x3               \n");
+} else {
+    ASM("       csrw     mepc, x3               \n");
+}
+    ASM("       lw       x3,    4(sp)           \n"     // pop ST into TMP
+        "       li      x10, %0                 \n"     // X10 is restored below
+        "       or       x3, x3, x10            \n" : : "i"(supervisor ? SPP_S : MPP_M)); // see pop()
+    ASM("       lw       x1,    8(sp)           \n"     // pop RA
+        "       lw       x5,   12(sp)           \n"     // pop T0-T2, A0-A7 and T3-T6
+        "       lw       x6,   16(sp)           \n"
+        "       lw       x7,   20(sp)           \n"
+        "       lw      x10,   24(sp)           \n"
+        "       lw      x11,   28(sp)           \n"
+        "       lw      x12,   32(sp)           \n"
+        "       lw      x13,   36(sp)           \n"
+        "       lw      x14,   40(sp)           \n"
+        "       lw      x15,   44(sp)           \n"
+        "       lw      x16,   48(sp)           \n"
+        "       lw      x17,   52(sp)           \n"
+        "       lw      x28,   56(sp)           \n"
+        "       lw      x29,   60(sp)           \n"
+        "       lw      x30,   64(sp)           \n"
+        "       lw      x31,   68(sp)           \n"
+        "       addi    sp, sp, %0              \n" : : "i"(80));
+if(supervisor) {
+    ASM("       csrw    sstatus, x3             \n");
+} else {
+    ASM("       csrw    mstatus, x3             \n");
+}
+}
+
 inline CPU::Reg64 htole64(CPU::Reg64 v) { return CPU::htole64(v); }
 inline CPU::Reg32 htole32(CPU::Reg32 v) { return CPU::htole32(v); }
 inline CPU::Reg16 htole16(CPU::Reg16 v) { return CPU::htole16(v); }
@@ -26,6 +26,7 @@ public:
     using CPU_Common::Reg32;
     using CPU_Common::Reg64;
     using CPU_Common::Reg8;
+    using CPU_Common::SMP_Barrier;
 
     // Status Register ([m|s]status)
     typedef Reg Status;
@@ -68,6 +69,12 @@ public:
         SD = 1UL << 63      // Status Dirty = (FS | XS)
     };
 
+    // MENVCFG
+    enum : Reg
+    {
+        STCE = 1UL << 63    // Sstc: supervisor timer compare (stimecmp) Enabled
+    };
+
     // [M|S]TVEC modes
     enum : Reg
     {
@@ -200,6 +207,11 @@ public:
         static void pop(bool interrupt = false);  // interrupt or context switch?
         static void push(bool interrupt = false); // interrupt or context switch?
 
+        // Lean interrupt frame (PC, ST, RA, T0-T6 and A0-A7) for handlers that are plain functions: the ABI makes
+        // them preserve the callee-saved registers, and switch_context() saves those if the handler reschedules
+        static void pop_lean();
+        static void push_lean();
+
     private:
         Reg _pc;  // pc
         Reg _st;  // [m|s]status
@@ -293,7 +305,7 @@ public:
     static unsigned int cores() { return number_of_cores; }
     static bool is_smp() { return Traits<Machine>::multi; }
 
-    static void smp_barrier(unsigned long cores = CPU::cores()) { CPU_Common::smp_barrier<&finc>(cores, id()); }
+    static void smp_barrier(unsigned long cores = CPU::cores()) { CPU_Common::smp_barrier(cores, id()); }
 
     using CPU_Common::bus_clock;
     using CPU_Common::clock;
@@ -418,32 +430,7 @@ public:
     }*/
 
     template <typename T>
-    static T cas(volatile T &owner, T zero, T me)
-    {
-        // Carregar o owner no old;
-        // Checar se o owner é zero;
-        // Se não for zero tem dono e retornamos owner;
-        // Se for zero, trocamos o owner por me;
-        // Saimos da função retornando "Zero"
-        register T old;
-        T temp = 0;
-        if (sizeof(T) == sizeof(Reg64))
-            ASM("1: amoadd.d      %0, x0, (%1)         \n"
-                "   bne            %0, %2, 2f          \n"
-                "   amoswap.d      %4, %3, (%1)        \n"
-                "2:                         \n" : "=&r"(old) : "r"(&owner), "r"(zero), "r"(me), "r"(temp) : "cc", "memory");
-
-        else
-            ASM("1: amoadd.w      %0, x0, (%1)         \n"
-                "   bne            %0, %2, 2f          \n"
-                "   amoswap.w      %4, %3, (%1)        \n"
-                "2:                         \n" : "=&r"(old) : "r"(&owner), "r"(zero), "r"(me), "r"(temp) : "cc", "memory");
-
-        return old;
-    }
-    /*
-    template <typename T>
-    static T cas(volatile T &owner, T zero, T me)
+    static T cas(volatile T &value, T compare, T replacement)
     {
         register T old;
         if (sizeof(T) == sizeof(Reg64))
@@ -451,18 +438,22 @@ public:
                 "   bne     %0, %2, 2f      \n"
                 "   sc.d    t3, %3, (%1)    \n"
                 "   bnez    t3, 1b          \n"
-                "2:                         \n" : "=&r"(old) : "r"(&owner), "r"(zero), "r"(me) : "t3", "cc", "memory");
+                "2:                         \n" : "=&r"(old) : "r"(&value), "r"(compare), "r"(replacement) : "t3", "cc", "memory");
         else
             ASM("1: lr.w    %0, (%1)        \n"
                 "   bne     %0, %2, 2f      \n"
                 "   sc.w    t3, %3, (%1)    \n"
                 "   bnez    t3, 1b          \n"
-                "2:                         \n" : "=&r"(old) : "r"(&owner), "r"(zero), "r"(me) : "t3", "cc", "memory");
+                "2:                         \n" : "=&r"(old) : "r"(&value), "r"(compare), "r"(replacement) : "t3", "cc", "memory");
         return old;
-    }*/
+    }
+
+    using CPU_Common::fence;
 
     static void flush_tlb() { ASM("sfence.vma" : : : "memory"); }
     static void flush_tlb(Reg addr) { ASM("sfence.vma %0" : : "r"(addr) : "memory"); }
+    static void flush_tlb(Reg addr, Reg asid) { ASM("sfence.vma %0, %1" : : "r"(addr), "r"(asid) : "memory"); }
+    static void flush_asid(Reg asid) { ASM("sfence.vma zero, %0" : : "r"(asid) : "memory"); }
 
     using CPU_Common::htole16;
     using CPU_Common::htole32;
@@ -653,6 +644,15 @@ public:
         return r;
     }
 
+    // menvcfg only exists from the 1.12 privileged spec on and older assemblers don't know it, hence the CSR number
+    static void menvcfgs(Reg r) { ASM("csrs 0x30a, %0" : : "r"(r) : "cc"); }
+    static Reg menvcfg()
+    {
+        Reg r = 0; // left at 0 if the access traps and the trap handler skips it
+        ASM("csrr %0, 0x30a" : "+r"(r) : :);
+        return r;
+    }
+
     // Supervisor mode
     static void sint_enable() { ASM("csrsi sstatus, %0" : : "i"(SIE) : "cc"); }
     static void sint_disable() { ASM("csrci sstatus, %0" : : "i"(SIE) : "cc"); }
@@ -730,11 +730,7 @@ public:
 
     static void sret() { ASM("sret"); }
 
-    static void satp(Reg r)
-    {
-        ASM("csrw satp, %0" : : "r"(r) : "cc");
-        ASM("sfence.vma" : : : "memory");
-    }
+    static void satp(Reg r) { ASM("csrw satp, %0" : : "r"(r) : "cc"); } // callers decide what to flush (see SV39_MMU::pd())
     static Reg satp()
     {
         Reg r;
@@ -742,6 +738,17 @@ public:
         return r;
     }
 
+    // Sstc timer compare, accessible only if machine mode set menvcfg.STCE (see sstc())
+    static void stimecmp(Reg64 v) { ASM("csrw 0x14d, %0" : : "r"(v) : "cc"); }
+    static Reg64 stimecmp()
+    {
+        Reg64 r = 0;
+        ASM("csrr %0, 0x14d" : "+r"(r) : :);
+        return r;
+    }
+
+    static bool sstc();
+
 private:
     template <typename Head, typename... Tail>
     static void init_stack_helper(Log_Addr sp, Head head, Tail... tail)
@@ -751,6 +758,8 @@ private:
     }
     static void init_stack_helper(Log_Addr sp) {}
 
+    static void skip() __attribute__((naked, aligned(4)));
+
     static void init();
 
 private:
@@ -873,6 +882,86 @@ inline void CPU::Context::pop(bool interrupt)
     }
 }
 
+inline void CPU::Context::push_lean()
+{
+    ASM("       addi     sp, sp, %0             \n" : : "i"(-144)); // 144 bytes keep SP 16-byte aligned
+    if (supervisor)
+    {
+        ASM("       csrr     x3,    sepc            \n");
+    }
+    else
+    {
+        ASM("       csrr     x3,    mepc            \n");
+    }
+    ASM("       sd       x3,    0(sp)           \n"); // push PC
+    if (supervisor)
+    {
+        ASM("       csrr     x3, sstatus            \n");
+    }
+    else
+    {
+        ASM("       csrr     x3, mstatus            \n");
+    }
+    ASM("       sd       x3,    8(sp)           \n"     // push ST
+        "       sd       x1,   16(sp)           \n"     // push RA
+        "       sd       x5,   24(sp)           \n"     // push T0-T2, A0-A7 and T3-T6
+        "       sd       x6,   32(sp)           \n"
+        "       sd       x7,   40(sp)           \n"
+        "       sd      x10,   48(sp)           \n"
+        "       sd      x11,   56(sp)           \n"
+        "       sd      x12,   64(sp)           \n"
+        "       sd      x13,   72(sp)           \n"
+        "       sd      x14,   80(sp)           \n"
+        "       sd      x15,   88(sp)           \n"
+        "       sd      x16,   96(sp)           \n"
+        "       sd      x17,  104(sp)           \n"
+        "       sd      x28,  112(sp)           \n"
+        "       sd      x29,  120(sp)           \n"
+        "       sd      x30,  128(sp)           \n"
+        "       sd      x31,  136(sp)           \n");
+}
+
+inline void CPU::Context::pop_lean()
+{
+    ASM("       ld       x3,    0(sp)           \n"); // pop PC into TMP
+    if (supervisor)
+    {
+        ASM("       csrw     sepc, x3               \n");
+    }
+    else
+    {
+        ASM("       csrw     mepc, x3               \n");
+    }
+    ASM("       ld       x3,    8(sp)           \n"     // pop ST into TMP
+        "       li      x10, %0                 \n"     // X10 is restored below
+        "       or       x3, x3, x10            \n" : : "i"(supervisor ? SPP_S : MPP_M)); // see pop()
+    ASM("       ld       x1,   16(sp)           \n"     // pop RA
+        "       ld       x5,   24(sp)           \n"     // pop T0-T2, A0-A7 and T3-T6
+        "       ld       x6,   32(sp)           \n"
+        "       ld       x7,   40(sp)           \n"
+        "       ld      x10,   48(sp)           \n"
+        "       ld      x11,   56(sp)           \n"
+        "       ld      x12,   64(sp)           \n"
+        "       ld      x13,   72(sp)           \n"
+        "       ld      x14,   80(sp)           \n"
+        "       ld      x15,   88(sp)           \n"
+        "       ld      x16,   96(sp)           \n"
+        "       ld      x17,  104(sp)           \n"
+        "       ld      x28,  112(sp)           \n"
+        "       ld      x29,  120(sp)           \n"
+        "       ld      x30,  128(sp)           \n"
+        "       ld      x31,  136(sp)           \n"
+        "       addi    sp, sp, %0              \n" : : "i"(144));
+    if (supervisor)
+    {
+        ASM("       csrw    sstatus, x3             \n");
+    }
+    else
+    {
+        ASM("       csrw    mstatus, x3             \n");
+    }
+}
+
 inline CPU::Reg64 htole64(CPU::Reg64 v) { return CPU::htole64(v); }
 inline CPU::Reg32 htole32(CPU::Reg32 v) { return CPU::htole32(v); }
 inline CPU::Reg16 htole16(CPU::Reg16 v) { return CPU::htole16(v); }
@@ -7,6 +7,8 @@
 #include <architecture/mmu.h>
 #undef __mmu_common_only__
 #include <system/memory_map.h>
+#include <utility/buddy.h>
+#include <utility/range_tree.h>
 
 __BEGIN_SYS
 
@@ -16,15 +18,24 @@ class SV39_MMU: public MMU_Common<9, 9, 12, 9>
     friend class Setup;
 
 private:
-    typedef Grouping_List<Frame> List;
     typedef MMU_Common<9, 9, 12, 9> Common;
 
     static const bool colorful = Traits<MMU>::colorful;
     static const unsigned long COLORS = Traits<MMU>::COLORS;
     static const unsigned long RAM_BASE = Memory_Map::RAM_BASE;
+    static const unsigned long RAM_TOP = Memory_Map::RAM_TOP;
     static const unsigned long PHY_MEM = Memory_Map::PHY_MEM;
     static const unsigned long APP_LOW = Memory_Map::APP_LOW;
     static const unsigned long APP_HIGH = Memory_Map::APP_HIGH;
+    static const unsigned long APP_UNITS = (APP_HIGH - APP_LOW + 1) / PT_SPAN; // Big_Pages in the application range (one attacher entry each)
+
+    static const unsigned int ASIDS = Traits<MMU>::ASIDS;
+    static const unsigned int ASID_SHIFT = 44;
+    static const unsigned long ASID_MASK = 0xffffUL;
+    static const unsigned long PPN_MASK = (1UL << ASID_SHIFT) - 1;
+    static const unsigned long MODE_SV39 = 8UL << 60;
+    static const unsigned long SHOOTDOWN_PAGES = 32; // above this, flushing the whole ASID is cheaper than page by page
+    static const unsigned int ZEROED_FRAMES = Traits<MMU>::ZEROED_FRAMES;
 
 public:
     // Page Flags
@@ -42,6 +53,7 @@ public:
             D    = 1 << 7, // Dirty
             CT   = 1 << 8, // Contiguous (reserved for use by supervisor RSW)
             MIO  = 1 << 9, // I/O (reserved for use by supervisor RSW)
+            CW   = MIO,    // Copy-on-write, on pages without W (I/O pages are never shared that way)
 
             IAD  = (Traits<Build>::MODEL == Traits<Build>::SiFive_U) ? A | D : 0, // SiFive-U RV64 MMU can't handle A and D and requires it to be set
 
@@ -115,8 +127,33 @@ public:
                 }
         }
 
-        void map_contiguous(int from, int to, Page_Flags flags, Color color) {
-            remap(alloc(to - from, color), from, to, flags);
+        // Lazy entries keep the flags but not V, so the first access faults and SV39_MMU::fault() backs them
+        void map_lazy(int from, int to, Page_Flags flags) {
+            for( ; from < to; from++) {
+                Log_Addr * pte = phy2log(&_entry[from]);
+                *pte = flags & ~Page_Flags::V;
+            }
+        }
+
+        // One frame at a time, taking the set's colors in turn
+        void map(int from, int to, Page_Flags flags, const Color_Set & colors) {
+            if(!colorful || (colors.count() <= 1)) {
+                map(from, to, flags, colorful ? colors[0] : WHITE);
+                return;
+            }
+            for( ; from < to; from++) {
+                Log_Addr * pte = phy2log(&_entry[from]);
+                *pte = phy2pte(alloc(1, colors[from]), flags);
+            }
+        }
+
+        // Fails, leaving the entries untouched, if no run of to - from free frames is left
+        bool map_contiguous(int from, int to, Page_Flags flags, Color color) {
+            Phy_Addr frames = alloc(to - from, color);
+            if(!frames)
+                return false;
+            remap(frames, from, to, flags);
+            return true;
         }
 
         void remap(Phy_Addr addr, int from, int to, Page_Flags flags) {
@@ -128,16 +165,23 @@ public:
             }
         }
 
+        // Shared copy-on-write pages stay read-only until written
         void reflag(int from, int to, Page_Flags flags) {
             for( ; from < to; from++) {
                 Log_Addr * pte = phy2log(&_entry[from]);
-                *pte = phy2pte(pte2phy(_entry[from]), flags);
+                if(lazy(_entry[from]))
+                    *pte = flags & ~Page_Flags::V;
+                else if(cow(_entry[from]) && (flags & Page_Flags::W))
+                    *pte = phy2pte(pte2phy(_entry[from]), (flags & ~Page_Flags::W) | Page_Flags::CW);
+                else
+                    *pte = phy2pte(pte2phy(_entry[from]), flags);
             }
         }
 
         void unmap(int from, int to) {
             for( ; from < to; from++) {
-                free(_entry[from]);
+                if(_entry[from] & Page_Flags::V)
+                    release(pte2phy(_entry[from]));
                 Log_Addr * pte = phy2log(&_entry[from]);
                 *pte = 0;
             }
@@ -175,37 +219,84 @@ public:
     class Chunk
     {
     public:
-        Chunk(const Chunk & c): _free(false), _from(c._from), _to(c._to), _pts(c._pts), _flags(c._flags), _pt(c._pt) {} // avoid freeing memory when temporaries are created
-
-        Chunk(unsigned long bytes, Flags flags, Color color = WHITE)
-        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)) {
-            if(_flags & Page_Flags::CT)
-                _pt->map_contiguous(_from, _to, _flags, color);
+        Chunk(const Chunk & c): _free(false), _lazy(c._lazy), _fixed(c._fixed), _from(c._from), _to(c._to), _pts(c._pts), _flags(c._flags), _pt(c._pt) {} // avoid freeing memory when temporaries are created
+
+        // With Flags::LZ (and not CT), no frames are allocated up front: each page gets a zeroed frame on its first access.
+        // Frames come from "colors" (contiguous chunks and lazy pages, which take the color of the page table, use only the first one).
+        // Only contiguous chunks with Flags::FX, which can then be neither reflagged nor resized, are attached with 2 MiB leaves (see pt2ate()).
+        Chunk(unsigned long bytes, Flags flags, const Color_Set & colors = WHITE)
+        : _free(true), _lazy((flags & Flags::LZ) && !(flags & Flags::CT)), _fixed(flags & Flags::FX), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)),
+          _pt(calloc(_pts, (colorful && _lazy) ? colors[0] : WHITE)) {
+            if(_flags & Page_Flags::CT) {
+                if(!_pt->map_contiguous(_from, _to, _flags, colorful ? colors[0] : WHITE))
+                    fail(bytes);
+            } else if(_lazy)
+                _pt->map_lazy(_from, _to, _flags);
             else
-                _pt->map(_from, _to, _flags, color);
+                _pt->map(_from, _to, _flags, colors);
+        }
+
+        // Clone of another chunk. With copy_on_write, both share the frames read-only until one of them writes
+        // to a page, when SV39_MMU::fault() gives the writer a private copy; otherwise (and always for
+        // contiguous chunks) every frame is copied right away. Clones of I/O chunks map the same frames.
+        Chunk(const Chunk & c, bool copy_on_write)
+        : _free(true), _lazy(c._lazy), _fixed(c._fixed), _from(c._from), _to(c._to), _pts(c._pts), _flags(c._flags), _pt(calloc(_pts, WHITE)) {
+            Color color = colorful ? phy2color(c._pt) : WHITE;
+            Page_Table & src = c._pt->log();
+            Page_Table & dst = _pt->log();
+
+            if(_flags & Page_Flags::IO) {
+                for(unsigned int i = _from; i < _to; i++)
+                    dst[i] = src[i];
+            } else if(_flags & Page_Flags::CT) {
+                if(_pt->map_contiguous(_from, _to, _flags, color))
+                    memcpy(phy2log(pte2phy(dst[_from])), phy2log(pte2phy(src[_from])), size());
+                else
+                    fail(c.size());
+            } else {
+                for(unsigned int i = _from; i < _to; i++) {
+                    if(!(src[i] & Page_Flags::V))
+                        dst[i] = src[i]; // lazy pages stay lazy (and private) on both sides
+                    else if(copy_on_write) {
+                        share(pte2phy(src[i]));
+                        if(src[i] & Page_Flags::W)
+                            src[i] = phy2pte(pte2phy(src[i]), (pte2flg(src[i]) & ~Page_Flags::W) | Page_Flags::CW);
+                        dst[i] = src[i];
+                    } else {
+                        Phy_Addr frame = alloc(1, color);
+                        if(frame)
+                            memcpy(phy2log(frame), phy2log(pte2phy(src[i])), sizeof(Page));
+                        dst[i] = phy2pte(frame, cow(src[i]) ? Page_Flags((pte2flg(src[i]) & ~Page_Flags::CW) | Page_Flags::W) : pte2flg(src[i]));
+                    }
+                }
+                if(copy_on_write)
+                    shootdown(0, 0, 0); // the source may be attached anywhere with writable translations cached
+            }
         }
 
         Chunk(Phy_Addr phy_addr, unsigned long bytes, Flags flags)
-        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)) {
+        : _free(true), _lazy(false), _fixed(false), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)) {
             _pt->remap(phy_addr, _from, _to, flags);
         }
 
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags)
-        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt) {}
+        : _free(false), _lazy(false), _fixed(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt) {}
 
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags, Phy_Addr phy_addr)
-        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt) {
+        : _free(false), _lazy(false), _fixed(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt) {
             _pt->remap(phy_addr, _from, _to, flags);
         }
 
         ~Chunk() {
             if(_free) {
                 if(!(_flags & Page_Flags::IO)) {
-                    if(_flags & Page_Flags::CT)
-                        free((*_pt)[_from], _to - _from);
-                    else
+                    if(_flags & Page_Flags::CT) {
+                        if(_to > _from)
+                            free(pte2phy(_pt->log()[_from]), _to - _from);
+                    } else
                         for( ; _from < _to; _from++)
-                            free((*_pt)[_from]);
+                            if(_pt->log()[_from] & Page_Flags::V)
+                                release(pte2phy(_pt->log()[_from]));
                 }
                 free(_pt, _pts);
             }
@@ -215,8 +306,15 @@ public:
         Page_Flags flags() const { return _flags; }
         Page_Table * pt() const { return _pt; }
         unsigned long size() const { return (_to - _from) * sizeof(Page); }
-        
+        bool fixed() const { return _fixed; }
+
+        // Attacher-level leaves copy the flags of a fixed chunk's pages when it is attached, and nothing
+        // tracks where it is attached, so those leaves could not follow
         void reflag(Flags flags) {
+            if(_fixed) {
+                db<MMU>(WRN) << "MMU::Chunk::reflag(flags=" << flags << "): fixed chunk cannot be reflagged!" << endl;
+                return;
+            }
             _flags = flags;
             _pt->reflag(_from, _to, _flags);
         }
@@ -225,35 +323,94 @@ public:
             return (_flags & Page_Flags::CT) ? Phy_Addr(unflag((*_pt)[_from])) : Phy_Addr(false);
         }
 
+        // Growing extends the page-table array, and for contiguous chunks the frames, in place whenever the
+        // frames right after them are free; otherwise the page tables are copied (contiguous chunks cannot move
+        // and stay as they are). Shrinking unmaps the last pages and hands their frames back, but keeps the
+        // page tables, which a directory may still point to and which make growing again cheap.
         unsigned long resize(long amount) {
-            if(_flags & Page_Flags::CT)
-                return 0;
+            if(_fixed) {
+                db<MMU>(WRN) << "MMU::Chunk::resize(amount=" << amount << "): fixed chunk cannot be resized!" << endl;
+                return size();
+            }
 
             if(amount > 0) {
                 unsigned long pgs = pages(amount);
 
                 Color color = colorful ? phy2color(_pt) : WHITE;
 
+                Phy_Addr frames(false);
+                if(_flags & Page_Flags::CT) {
+                    if(_to > _from) {
+                        frames = pte2phy(_pt->log()[_to - 1]) + sizeof(Page);
+                        if(!claim(frames, pgs))
+                            frames = 0;
+                    } else
+                        frames = alloc(pgs, color);
+                    if(!frames) {
+                        db<MMU>(WRN) << "MMU::Chunk::resize(amount=" << amount << "): contiguous segment cannot grow in place!" << endl;
+                        return size();
+                    }
+                }
+
                 unsigned long free_pgs = _pts * PT_ENTRIES - _to;
                 if(free_pgs < pgs) { // resize _pt
                     unsigned long pts = _pts + Common::pts(pgs - free_pgs);
-                    Page_Table * pt = calloc(pts, color);
-                    memcpy(phy2log(pt), phy2log(_pt), _pts * sizeof(Page));
-                    free(_pt, _pts);
-                    _pt = pt;
+                    Phy_Addr next = Phy_Addr(_pt) + _pts * sizeof(Page);
+                    if(claim(next, pts - _pts))
+                        memset(phy2log(next), 0, (pts - _pts) * sizeof(Page));
+                    else {
+                        Page_Table * pt = calloc(pts, color);
+                        memcpy(phy2log(pt), phy2log(_pt), _pts * sizeof(Page));
+                        free(_pt, _pts);
+                        _pt = pt;
+                    }
                     _pts = pts;
                 }
 
-                _pt->map(_to, _to + pgs, _flags, color);
+                if(_flags & Page_Flags::CT)
+                    _pt->remap(frames, _to, _to + pgs, _flags);
+                else if(_lazy)
+                    _pt->map_lazy(_to, _to + pgs, _flags);
+                else
+                    _pt->map(_to, _to + pgs, _flags, color);
                 _to += pgs;
-            } else
-                db<MMU>(WRN) << "MMU::Chunk::resize(amount=" << amount << "): segment shrinking not implemented!" << endl;
+            } else if(amount < 0) {
+                unsigned long pgs = pages(-amount);
+                if(pgs > _to - _from)
+                    pgs = _to - _from;
+                if(!pgs)
+                    return size(); // nothing was mapped, so there is nothing to shoot down
+
+                Page_Table & pt = _pt->log();
+                if(_flags & Page_Flags::IO)
+                    for(unsigned int i = _to - pgs; i < _to; i++)
+                        pt[i] = 0; // not ours to free
+                else if(_flags & Page_Flags::CT) {
+                    free(pte2phy(pt[_to - pgs]), pgs);
+                    for(unsigned int i = _to - pgs; i < _to; i++)
+                        pt[i] = 0;
+                } else
+                    _pt->unmap(_to - pgs, _to); // lazy pages that were never touched have nothing to release
+                _to -= pgs;
+
+                shootdown(0, 0, 0); // the chunk may be attached anywhere with the dropped pages cached
+            }
 
             return size();
         }
 
+    private:
+        // A contiguous chunk that got no frames ends up empty (size() == 0 and phy_address() == 0), instead of
+        // mapping physical page 0
+        void fail(unsigned long bytes) {
+            db<MMU>(ERR) << "MMU::Chunk(bytes=" << bytes << ",flags=" << _flags << "): out of contiguous frames!" << endl;
+            _to = _from;
+        }
+
     private:
         bool _free;
+        bool _lazy;
+        bool _fixed;
         unsigned int _from;
         unsigned int _to;
         unsigned int _pts;
@@ -262,18 +419,49 @@ public:
     };
 
     // Directory (for Address_Space, an L2 SV39 page table)
+    // The application range is indexed by a Range_Tree of Big_Pages, so attach() finds room in O(log n),
+    // and attached chunks are remembered in a small open-addressing table keyed by their page tables, so
+    // find() does not have to walk the page directory. Copies share the page tables but carry a snapshot
+    // of both indices, so attach and detach must go through the original.
     class Directory
     {
+    private:
+        typedef Range_Tree<APP_UNITS> Ranges;
+
+        static const unsigned long CHUNKS = 2 * Ranges::LEAVES; // a power of two, at least twice the number of chunks that fit the application range
+        static const unsigned long GONE = 1; // tombstone (page tables are page aligned)
+
+        struct Attached {
+            Phy_Addr pt;
+            Log_Addr addr;
+        };
+
     public:
-        Directory(const Directory & d): _free(false), _pd(d._pd) {} // avoid freeing memory when temporaries are created
+        Directory(const Directory & d): _free(false), _pd(d._pd), _asid(d._asid), _ranges(d._ranges), _overflow(d._overflow) { // avoid freeing memory when temporaries are created
+            for(unsigned int i = 0; i < CHUNKS; i++)
+                _attached[i] = d._attached[i];
+        }
 
-        Directory(): _free(true), _pd(calloc(1, WHITE)) {
+        Directory(): _free(true), _pd(calloc(1, WHITE)), _asid(asid_alloc()), _overflow(false) {
             for(unsigned int i = 0; i < PD_ENTRIES; i++)
                 if(!((i >= pdi(APP_LOW)) && (i <= pdi(APP_HIGH))))
                     _pd->log()[i] = _master->log()[i];
+            for(unsigned int i = 0; i < CHUNKS; i++)
+                _attached[i].pt = 0;
         }
 
-        Directory(Page_Directory * pd): _free(false), _pd(pd) {}
+        // Wrapping the active page directory also picks up its ASID; any other one is treated as unknown (0), which flushes globally.
+        // Whatever is already mapped in the application range is reserved, but the chunks behind it are unknown, so find() falls back to a walk.
+        Directory(Page_Directory * pd): _free(false), _pd(pd), _asid((Phy_Addr(pd) == SV39_MMU::pd()) ? SV39_MMU::asid() : 0), _overflow(true) {
+            for(unsigned int i = 0; i < CHUNKS; i++)
+                _attached[i].pt = 0;
+            for(unsigned long u = 0; u < APP_UNITS; u++) {
+                Log_Addr addr = APP_LOW + u * PT_SPAN;
+                Attacher * at = pde2phy(_pd->log()[pdi(addr)]);
+                if(at && at->log()[ati(addr)])
+                    _ranges.reserve(u, 1);
+            }
+        }
 
         ~Directory() {
             if(_free) {
@@ -283,29 +471,37 @@ public:
                         free(at);
                 }
                 free(_pd);
+                asid_free(_asid);
             }
         }
 
         Phy_Addr pd() const { return _pd; }
+        unsigned int asid() const { return _asid; }
 
-        void activate() const { SV39_MMU::pd(_pd); }
+        void activate() const { SV39_MMU::pd(_pd, _asid); }
 
         Log_Addr find(const Chunk & chunk) {
+            for(unsigned long i = slot(chunk.pt()), n = 0; (n < CHUNKS) && _attached[i].pt; i = (i + 1) & (CHUNKS - 1), n++)
+                if(_attached[i].pt == Phy_Addr(chunk.pt()))
+                    return _attached[i].addr;
+            if(!_overflow)
+                return Log_Addr(false);
+
             for(unsigned int i = 0; i < PD_ENTRIES; i++) {
                 Attacher * at = pde2phy(_pd->log()[i]);
                 if(at)
                     for(unsigned int j = 0; j < AT_ENTRIES; j++)
-                        if(unflag(ate2phy(at->log()[j])) == unflag(chunk.pt()))
+                        if(maps(at->log()[j], chunk.pt()))
                             return (i << PD_SHIFT) + (j << AT_SHIFT);
             }
             return Log_Addr(false);
         }
 
         Log_Addr attach(const Chunk & chunk) {
-            for(Log_Addr addr = APP_LOW; addr < (APP_HIGH - chunk.size()); addr += sizeof(Big_Page))
-                if(attach(chunk, addr) == addr)
-                    return addr;
-            return Log_Addr(false);
+            unsigned long unit = _ranges.search(chunk.pts());
+            if(unit == Ranges::NONE)
+                return Log_Addr(false);
+            return attach(chunk, APP_LOW + unit * sizeof(Big_Page));
         }
 
         Log_Addr attach(const Chunk & chunk, Log_Addr addr) {
@@ -317,9 +513,12 @@ public:
                 db<MMU>(WRN) << "MMU::Directory::attach(chunk=" << &chunk << ",addr=" << addr << "): attaching chunk would reach beyond the limit of the address space!" << endl;
                 return Log_Addr(false);
             }
-            if(!attachable(addr, chunk.pt(), chunk.pts(), chunk.flags()))
+            if(app(addr, chunk.pts())) {
+                if(!_ranges.free(unit(addr), chunk.pts()))
+                    return Log_Addr(false);
+            } else if(!attachable(addr, chunk.pt(), chunk.pts(), chunk.flags()))
                 return Log_Addr(false);
-            return attach(addr, chunk.pt(), chunk.pts(), chunk.flags());
+            return attach(addr, chunk.pt(), chunk.pts(), chunk.fixed() && (chunk.flags() & Page_Flags::CT));
         }
 
         void detach(const Chunk & chunk) {
@@ -336,7 +535,10 @@ public:
 
         Phy_Addr physical(Log_Addr addr) {
             Attacher * at = _pd->log()[pdi(addr)];
-            Page_Table * pt = at->log()[ati(addr)];
+            PT_Entry ate = at->log()[ati(addr)];
+            if(leaf(ate))
+                return ate2phy(ate) | (addr & (PT_SPAN - 1));
+            Page_Table * pt = ate;
             return pt->log()[pti(addr)] | off(addr);
         };
 
@@ -354,7 +556,8 @@ public:
             return true;
         }
 
-        Log_Addr attach(Log_Addr addr, const Page_Table * pt, unsigned int pts, Page_Flags flags) {
+        Log_Addr attach(Log_Addr addr, const Page_Table * pt, unsigned int pts, bool large) {
+            const Page_Table * first = pt;
             for(unsigned int i = pdi(addr); i < pdi(addr) + ats(pts); i++) {
                 Attacher * at = pde2phy(_pd->log()[i]);
                 if(!at) {
@@ -362,43 +565,76 @@ public:
                     _pd->log()[i] = phy2pde(Phy_Addr(at));
                 }
                 for(unsigned int j = ati(addr); j < ati(addr) + pts; j++, pt++)
-                    at->log()[j & (AT_ENTRIES - 1)] = phy2ate(Phy_Addr(pt));
+                    at->log()[j & (AT_ENTRIES - 1)] = pt2ate(pt, large);
             }
+            if(app(addr, pts))
+                _ranges.reserve(unit(addr), pts);
+            remember(first, addr);
             return addr;
         }
 
         Log_Addr detach(Log_Addr addr, const Page_Table * pt, unsigned int pts) {
+            const Page_Table * first = pt;
             for(unsigned int i = pdi(addr); i < pdi(addr) + ats(pts); i++) {
                 Attacher * at = pde2phy(_pd->log()[i]);
                 if(at) {
                     for(unsigned int j = ati(addr); j < ati(addr) + pts; j++, pt++)
-                        if(unflag(ate2phy(at->log()[j & (AT_ENTRIES - 1)])) == unflag(pt))
+                        if(maps(at->log()[j & (AT_ENTRIES - 1)], pt))
                             at->log()[j] = 0;
                         else
                             return Log_Addr(false);
                 }
             }
-            flush_tlb();
+            if(app(addr, pts))
+                _ranges.release(unit(addr), pts);
+            forget(first, addr);
+            shootdown(addr, pts * PT_ENTRIES, _asid);
             return addr;
         }
 
+        static bool app(Log_Addr addr, unsigned int pts) { return (addr >= APP_LOW) && (unit(addr) <= APP_UNITS) && (pts <= APP_UNITS - unit(addr)); }
+        static unsigned long unit(Log_Addr addr) { return (addr - APP_LOW) / sizeof(Big_Page); }
+        static unsigned long slot(const Page_Table * pt) { return (Phy_Addr(pt) >> PT_SHIFT) & (CHUNKS - 1); }
+
+        void remember(const Page_Table * pt, Log_Addr addr) {
+            for(unsigned long i = slot(pt), n = 0; n < CHUNKS; i = (i + 1) & (CHUNKS - 1), n++)
+                if(!_attached[i].pt || (_attached[i].pt == GONE)) {
+                    _attached[i].pt = pt;
+                    _attached[i].addr = addr;
+                    return;
+                }
+            _overflow = true; // chunks attached outside the application range filled the table
+        }
+
+        void forget(const Page_Table * pt, Log_Addr addr) {
+            for(unsigned long i = slot(pt), n = 0; (n < CHUNKS) && _attached[i].pt; i = (i + 1) & (CHUNKS - 1), n++)
+                if((_attached[i].pt == Phy_Addr(pt)) && (_attached[i].addr == addr)) {
+                    _attached[i].pt = GONE;
+                    return;
+                }
+        }
+
     private:
         bool _free;
         Page_Directory * _pd;  // this is a physical address, but operator*() returns a logical address
+        unsigned int _asid;
+        Ranges _ranges;
+        Attached _attached[CHUNKS];
+        bool _overflow; // some chunks are missing from _attached, so find() must walk the page directory
     };
 
     // DMA_Buffer
     class DMA_Buffer: public Chunk
     {
     public:
-        DMA_Buffer(unsigned long s): Chunk(s, Flags::DMA) {
+        DMA_Buffer(unsigned long s): Chunk(s, Flags::DMA | Flags::FX) {
             Directory dir(current());
             _log_addr = dir.attach(*this);
             db<MMU>(TRC) << "MMU::DMA_Buffer(s=" << s << ") => " << this << endl;
             db<MMU>(INF) << "MMU::DMA_Buffer=" << *this << endl;
         }
 
-        DMA_Buffer(unsigned long s, Log_Addr d): Chunk(s, Flags::DMA) {
+        DMA_Buffer(unsigned long s, Log_Addr d): Chunk(s, Flags::DMA | Flags::FX) {
             Directory dir(current());
             _log_addr = dir.attach(*this);
             memcpy(_log_addr, d, s);
@@ -444,6 +680,15 @@ public:
         Page_Directory * _pd;
     };
 
+private:
+    // Free frames are managed by a buddy allocator per color, which keeps its links inside the free frames themselves
+    struct Frame_Translation
+    {
+        static void * log(unsigned long phy) { return phy2log(Phy_Addr(phy)); }
+    };
+
+    typedef Buddy_Allocator<sizeof(Frame), RAM_BASE, RAM_TOP - RAM_BASE + 1, Frame_Translation> Buddy;
+
 public:
     SV39_MMU() {}
 
@@ -451,9 +696,10 @@ public:
         Phy_Addr phy(false);
 
         if(frames) {
-            List::Element * e = _free[color].search_decrementing(frames);
-            if(e) {
-                phy = e->object() + e->size();
+            bool enabled = lock();
+            phy = _free[color].alloc(frames);
+            unlock(enabled);
+            if(phy) {
                 db<MMU>(TRC) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => " << phy << endl;
             } else
                 if(colorful)
@@ -465,9 +711,14 @@ public:
         return phy;
     }
 
+    // Single frames come from the pool the idle thread keeps zeroed (see prezero()) whenever it has some
     static Phy_Addr calloc(unsigned long frames = 1, Color color = WHITE) {
-        Phy_Addr phy = alloc(frames, color);
-        memset(phy2log(phy), 0, sizeof(Frame) * frames);
+        Phy_Addr phy = (frames == 1) ? zeroed(color) : Phy_Addr(false);
+        if(!phy) {
+            phy = alloc(frames, color);
+            if(phy)
+                memset(phy2log(phy), 0, sizeof(Frame) * frames);
+        }
         return phy;
     }
 
@@ -479,10 +730,27 @@ public:
         db<MMU>(TRC) << "MMU::free(frame=" << frame << ",color=" << color << ",n=" << n << ")" << endl;
 
         if(frame && n) {
-            List::Element * e = new (phy2log(frame)) List::Element(frame, n);
-            List::Element * m1, * m2;
-            _free[color].insert_merging(e, &m1, &m2);
+            bool enabled = lock();
+            _free[color].free(frame, n);
+            unlock(enabled);
+        }
+    }
+
+    // Allocates exactly [frame, frame + n) if all of it is free, e.g. to grow an allocation in place
+    static bool claim(Phy_Addr frame, unsigned long n = 1) {
+        frame = unflag(frame);
+        Color color = colorful ? phy2color(frame) : WHITE;
+
+        bool claimed = false;
+        if(frame) {
+            bool enabled = lock();
+            claimed = _free[color].claim(frame, n);
+            unlock(enabled);
         }
+
+        db<MMU>(TRC) << "MMU::claim(frame=" << frame << ",color=" << color << ",n=" << n << ") => " << claimed << endl;
+
+        return claimed;
     }
 
     static void white_free(Phy_Addr frame, unsigned long n) {
@@ -492,20 +760,52 @@ public:
         db<MMU>(TRC) << "MMU::free(frame=" << frame << ",color=" << WHITE << ",n=" << n << ")" << endl;
 
         if(frame && n) {
-            List::Element * e = new (phy2log(frame)) List::Element(frame, n);
-            List::Element * m1, * m2;
-            _free[WHITE].insert_merging(e, &m1, &m2);
+            bool enabled = lock();
+            _free[WHITE].free(frame, n);
+            unlock(enabled);
         }
     }
 
-    static unsigned long allocable(Color color = WHITE) { return _free[color].head() ? _free[color].head()->size() : 0; }
+    static unsigned long allocable(Color color = WHITE) {
+        bool enabled = lock();
+        unsigned long frames = _free[color].largest();
+        unlock(enabled);
+        return frames;
+    }
+
+    // Free-memory statistics, e.g. to watch fragmentation build up over long uptimes
+    static unsigned long free_frames(Color color = WHITE) {
+        bool enabled = lock();
+        unsigned long frames = _free[color].available();
+        unlock(enabled);
+        return frames;
+    }
+
+    static unsigned int fragmentation(Color color = WHITE) {
+        bool enabled = lock();
+        unsigned int f = _free[color].fragmentation();
+        unlock(enabled);
+        return f;
+    }
+
+    static void dump_free(Color color = WHITE) {
+        bool enabled = lock(); // the buddy is walked while printing it
+        db<MMU>(INF) << "MMU::free[" << color << "]=" << _free[color] << endl;
+        unlock(enabled);
+    }
+
+    // Tops up the pools of zeroed frames through the locked alloc() and free(); called by the idle thread of every hart before it halts, with interrupts enabled
+    static void prezero();
 
     static Page_Directory * volatile current() { return static_cast<Page_Directory * volatile>(pd()); }
 
     static Phy_Addr physical(Log_Addr addr) {
         Page_Directory * pd = current();
         Attacher * at = pd->log()[pdi(addr)];
-        Page_Table * pt = at->log()[ati(addr)];
+        PT_Entry ate = at->log()[ati(addr)];
+        if(leaf(ate))
+            return ate2phy(ate) | (addr & (PT_SPAN - 1));
+        Page_Table * pt = ate;
         return pt->log()[pti(addr)] | off(addr);
     }
 
@@ -519,6 +819,36 @@ public:
     static Phy_Addr   pde2phy(PD_Entry entry) { return (entry & ~Page_Flags::MASK) << 2; }
     static Page_Flags pde2flg(PT_Entry entry) { return (entry & Page_Flags::MASK); }
 
+    // Non-leaf entries have R, W and X clear; anything else maps memory directly (a megapage at the Attacher level)
+    static bool leaf(PT_Entry entry) { return entry & (Page_Flags::R | Page_Flags::W | Page_Flags::X); }
+
+    // A page of a lazy chunk that has not been touched yet (flags but no frame, see _Page_Table::map_lazy())
+    static bool lazy(PT_Entry entry) { return entry && !(entry & Page_Flags::V); }
+
+    // A page shared copy-on-write with other chunks (see Chunk(const Chunk &, bool))
+    static bool cow(PT_Entry entry) { return (entry & Page_Flags::V) && (entry & Page_Flags::CW) && !(entry & Page_Flags::W); }
+
+    // Attacher entry for a page table: a 2 MiB leaf when large pages are allowed, i.e. the table belongs to a
+    // fixed contiguous chunk (see Chunk), and its 512 entries map a naturally aligned frame run, a pointer to
+    // the table otherwise. Leaves copy the flags of the table's entries at attach time, hence "fixed".
+    static PT_Entry pt2ate(const Page_Table * pt, bool large) {
+        if(large) {
+            Page_Table & t = const_cast<Page_Table *>(pt)->log();
+            Phy_Addr first = pte2phy(t[0]);
+            if((t[0] & Page_Flags::V) && !(first & (PT_SPAN - 1))
+               && (t[PT_ENTRIES - 1] & Page_Flags::V) && (pte2phy(t[PT_ENTRIES - 1]) == first + (PT_ENTRIES - 1) * sizeof(Page)))
+                return phy2pte(first, pte2flg(t[0]));
+        }
+        return phy2ate(Phy_Addr(pt));
+    }
+
+    // Whether an Attacher entry (leaf or not) was produced by pt2ate() for pt
+    static bool maps(PT_Entry ate, const Page_Table * pt) {
+        if(leaf(ate))
+            return ate2phy(ate) == pte2phy(const_cast<Page_Table *>(pt)->log()[0]);
+        return unflag(ate2phy(ate)) == unflag(Phy_Addr(pt));
+    }
+
 #ifdef __setup__
     // SETUP may use the MMU to build a primordial memory model before turning the MMU on, so no log vs phy adjustments are made
     static Log_Addr phy2log(Phy_Addr phy) { return Log_Addr((RAM_BASE == PHY_MEM) ? phy : (RAM_BASE > PHY_MEM) ? phy : phy ); }
@@ -540,20 +870,96 @@ public:
             return WHITE;
     }
 
+    // Page fault hook for IC::exception(): backs a lazy page of the current address space with a zeroed frame.
+    // Returns true if the faulting access should be retried.
+    static bool fault(Log_Addr addr, bool write);
+
+    // Invalidates "pages" pages from "addr" (the whole ASID if pages is 0) on every hart that may cache them
+    // (all harts for ASID 0), waiting for the remote ones to acknowledge
+    static void shootdown(Log_Addr addr, unsigned long pages, unsigned int asid);
+
 private:
-    static Phy_Addr pd() { return CPU::satp() << PT_SHIFT; }
-    static void pd(Phy_Addr pd) { CPU::satp((1UL << 63) | (pd >> PT_SHIFT)); }
+    static Phy_Addr pd() { return (CPU::satp() & PPN_MASK) << PT_SHIFT; }
+    static unsigned int asid() { return (CPU::satp() >> ASID_SHIFT) & ASID_MASK; }
+
+    static void pd(Phy_Addr pd) {
+        CPU::satp(MODE_SV39 | (pd >> PT_SHIFT));
+        CPU::flush_tlb();
+    }
+
+    // Entries tagged with a live ASID stay valid across switches, so only untagged (ASID 0) switches flush.
+    // The hart is recorded as a possible holder of the ASID's entries until the ASID is released.
+    static void pd(Phy_Addr pd, unsigned int asid) {
+        if(asid) {
+            unsigned long self = 1UL << CPU::id();
+            unsigned long harts;
+            while(!((harts = _harts[asid]) & self) && (CPU::cas(_harts[asid], harts, harts | self) != harts));
+        }
+        CPU::satp(MODE_SV39 | (Reg(asid) << ASID_SHIFT) | (pd >> PT_SHIFT));
+        if(!asid)
+            CPU::flush_tlb();
+    }
 
     static void flush_tlb() { CPU::flush_tlb(); }
     static void flush_tlb(Log_Addr addr) { CPU::flush_tlb(addr); }
+    static void flush_tlb(Log_Addr addr, unsigned long pages, unsigned int asid);
+
+    static Phy_Addr zeroed(Color color);
+
+    // Frame allocator lock, always taken with interrupts disabled and innermost (fault() takes it under _fault_lock)
+    static bool lock() {
+        bool enabled = CPU::int_enabled();
+        CPU::int_disable();
+        while(CPU::tsl(_free_lock));
+        return enabled;
+    }
+
+    static void unlock(bool enabled) {
+        _free_lock = false;
+        if(enabled)
+            CPU::int_enable();
+    }
+
+    // Frames shared by copy-on-write clones carry a count of extra references; release() frees a frame once none are left
+    static void share(Phy_Addr frame);
+    static void release(Phy_Addr frame);
+
+    static unsigned int asid_alloc();
+    static void asid_free(unsigned int asid);
+
+    static void shootdown_handler(CPU::Interrupt_Id i);
 
     static void init();
 
 private:
-    static List _free[colorful * COLORS + 1]; // +1 for WHITE
+    static Buddy _free[colorful * COLORS + 1]; // +1 for WHITE
+    static volatile bool _free_lock; // serializes every access to _free, across harts and against interrupt handlers
     static Page_Directory * _master;
+
+    // ASIDs in use and the number the hardware actually implements (probed at init; <= 1 means none)
+    static Bitmap<ASIDS> _asids;
+    static unsigned int _asid_count;
+    static volatile bool _asid_lock;
+    static volatile unsigned long _harts[ASIDS]; // harts that have loaded each ASID since it was allocated
+
+    // Single shootdown request, serialized by _shootdown_lock
+    static volatile bool _shootdown_lock;
+    static Log_Addr _shootdown_addr;
+    static unsigned long _shootdown_pages;
+    static unsigned int _shootdown_asid;
+    static volatile unsigned long _shootdown_pending; // harts that have not acknowledged yet
+
+    static volatile bool _fault_lock; // serializes page fills and copies, and guards _shares; frames are still allocated under _free_lock
+    static unsigned short _shares[(RAM_TOP - RAM_BASE + 1) / sizeof(Frame)]; // extra references to each frame
+
+    // Zeroed frames, per color
+    static Phy_Addr _zeroed[colorful * COLORS + 1][ZEROED_FRAMES + 1]; // +1 so the pool can be disabled
+    static unsigned int _zeroed_count[colorful * COLORS + 1];
+    static volatile bool _zeroed_lock;
 };
 
+// SV39_MMU is not selected yet: LIBRARY mode still runs on the flat No_MMU, so the code above is
+// only compiled, never run. Switching to it needs booting with paging on, which has not been done.
 class MMU: public No_MMU {};
 
 __END_SYS
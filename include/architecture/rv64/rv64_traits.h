@@ -20,6 +20,8 @@ template<> struct Traits<MMU>: public Traits<Build>
 {
     static const bool colorful = false;
     static const unsigned int COLORS = 1;
+    static const unsigned int ASIDS = 256;      // address-space identifiers handed out to Directories (0 is shared); the hardware may support fewer
+    static const unsigned int ZEROED_FRAMES = 64; // frames per color kept zeroed by the idle thread for calloc(); 0 disables the pool
 };
 
 template<> struct Traits<FPU>: public Traits<Build>
@@ -0,0 +1,175 @@
+// EPOS Shared-Memory Channel Declarations
+
+// A Channel moves buffers from a sending to a receiving Address_Space without
+// copying them. Each of its BUFFERS buffers is a Segment of its own and is
+// attached to exactly one side at a time. acquire() hands the sender an empty
+// buffer. send() detaches it from the sender and attaches it to the receiver,
+// so only page-table entries change hands while the frames stay put. receive()
+// returns it to the receiver, and release() moves it back to the sender.
+// Buffer indices travel through two Blocking_Rings of MPMC_Rings, one of empty
+// and one of full buffers. The sender sleeps on the first when all buffers are
+// in use, and the receiver on the second, its doorbell, when none has arrived.
+// Neither side holds a Semaphore the other one releases, so no priority ceiling
+// zone is left behind. Buffers are named by their address on the side that
+// owns them. When both sides are the same Address_Space, nothing is remapped.
+// If a buffer cannot be attached to the other side, it is attached back where
+// it was, send() or release() returns false, and the caller keeps the buffer.
+
+#ifndef __channel_h
+#define __channel_h
+
+#include <architecture.h>
+#include <memory.h>
+#include <synchronizer.h>
+#include <utility/ring.h>
+
+__BEGIN_SYS
+
+template<unsigned int BUFFERS = 4>
+class Channel
+{
+public:
+    typedef CPU::Log_Addr Log_Addr;
+    typedef Segment::Flags Flags;
+
+private:
+    typedef Blocking_Ring<MPMC_Ring<unsigned int, BUFFERS>> Ring;
+
+    enum Owner : unsigned int { MOVING, SENDER, RECEIVER };
+
+public:
+    Channel(unsigned long buffer_size, Address_Space * sender, Address_Space * receiver, Flags flags = Flags::APPD)
+    : _sender(sender), _receiver(receiver)
+    {
+        db<Segment>(TRC) << "Channel(size=" << buffer_size << ",tx=" << sender << ",rx=" << receiver << ") => " << this << endl;
+
+        for (unsigned int i = 0; i < BUFFERS; i++)
+        {
+            _buffer[i] = new (SYSTEM) Segment(buffer_size, flags);
+            _address[i] = _sender->attach(_buffer[i]);
+            _length[i] = 0;
+            _owner[i] = SENDER;
+            _empty.try_insert(i);
+        }
+    }
+
+    ~Channel()
+    {
+        db<Segment>(TRC) << "~Channel(this=" << this << ")" << endl;
+
+        for (unsigned int i = 0; i < BUFFERS; i++)
+        {
+            if (_owner[i] != MOVING)
+                ((_owner[i] == SENDER) ? _sender : _receiver)->detach(_buffer[i], _address[i]);
+            delete _buffer[i];
+        }
+    }
+
+    unsigned long buffer_size() const { return _buffer[0]->size(); }
+
+    // Sender side: blocks until an empty buffer is available and returns its address in the sender
+    Log_Addr acquire()
+    {
+        return _address[_empty.remove()];
+    }
+
+    // Sender side: hands "length" bytes at "buffer" (from acquire()) to the receiver and rings the doorbell
+    bool send(Log_Addr buffer, unsigned long length)
+    {
+        unsigned int i = index(buffer, SENDER);
+        if (i == BUFFERS)
+        {
+            db<Segment>(WRN) << "Channel::send(buffer=" << buffer << "): not a buffer of this channel held by the sender!" << endl;
+            return false;
+        }
+
+        _length[i] = (length < _buffer[i]->size()) ? length : _buffer[i]->size();
+        if (!move(i, _sender, _receiver, RECEIVER))
+            return false;
+        _full.insert(i);
+        return true;
+    }
+
+    // Receiver side: sleeps on the doorbell until a buffer arrives and returns its address in the receiver
+    Log_Addr receive(unsigned long * length = 0)
+    {
+        unsigned int i = _full.remove();
+        if (length)
+            *length = _length[i];
+        return _address[i];
+    }
+
+    // Receiver side: gives "buffer" (from receive()) back to the sender to be reused
+    bool release(Log_Addr buffer)
+    {
+        unsigned int i = index(buffer, RECEIVER);
+        if (i == BUFFERS)
+        {
+            db<Segment>(WRN) << "Channel::release(buffer=" << buffer << "): not a buffer of this channel held by the receiver!" << endl;
+            return false;
+        }
+
+        if (!move(i, _receiver, _sender, SENDER))
+            return false;
+        _empty.insert(i);
+        return true;
+    }
+
+private:
+    unsigned int index(Log_Addr buffer, Owner owner) const
+    {
+        for (unsigned int i = 0; i < BUFFERS; i++)
+        {
+            if (_owner[i] != owner)
+                continue;
+            CPU::fence(); // read the address published together with the owner
+            if (_address[i] == buffer)
+                return i;
+        }
+        return BUFFERS;
+    }
+
+    // Remaps buffer i from one side to the other; the owner is only published once the new address is valid.
+    // On failure, the buffer goes back to the same address on the side it came from, which keeps owning it.
+    bool move(unsigned int i, Address_Space * from, Address_Space * to, Owner owner)
+    {
+        if (from == to)
+        {
+            _owner[i] = owner;
+            return true;
+        }
+
+        Owner previous = _owner[i];
+        _owner[i] = MOVING;
+        CPU::fence();
+        from->detach(_buffer[i], _address[i]);
+        Log_Addr address = to->attach(_buffer[i]);
+        if (!address)
+        {
+            db<Segment>(WRN) << "Channel::move(buffer=" << i << "): failed to attach to " << to << "!" << endl;
+            if (from->attach(_buffer[i], _address[i]) != _address[i])
+                db<Segment>(ERR) << "Channel::move(buffer=" << i << "): failed to attach back to " << from << "!" << endl;
+            CPU::fence();
+            _owner[i] = previous;
+            return false;
+        }
+        _address[i] = address;
+        CPU::fence();
+        _owner[i] = owner;
+        return true;
+    }
+
+private:
+    Address_Space * _sender;
+    Address_Space * _receiver;
+    Segment * _buffer[BUFFERS];
+    Log_Addr _address[BUFFERS];
+    unsigned long _length[BUFFERS];
+    volatile Owner _owner[BUFFERS];
+    Ring _empty;
+    Ring _full;
+};
+
+__END_SYS
+
+#endif
@@ -0,0 +1,156 @@
+// EPOS Threaded Interrupt Handler Declarations
+
+// An Interrupt_Thread splits the handling of an interrupt in two halves. The
+// top half runs in interrupt context. It masks the source with IC::disable(),
+// so a level-triggered device cannot fire again once the IC acknowledges it
+// (e.g. when the PLIC claim is completed; on RISC-V, IC::disable() only zeroes
+// the source's priority, so that completion still takes effect), and then
+// wakes the bottom half through a Semaphore. The bottom half is an ordinary
+// Thread with its own Criterion. It calls the handler and only then unmasks
+// the source. Driver work thus runs preemptible and is scheduled like any
+// other task. Under GLLF or PLLF, a criterion sized for the device's worst
+// case (period = minimum inter-arrival time, capacity = handler WCET) lets it be
+// accounted for in the real-time analysis.
+
+// With Traits<IC>::balanced, the Interrupt_Balancer picks the hart each
+// Interrupt_Thread's source is routed to (see IC::affinity()). It prefers harts
+// with no hard real-time partition, i.e. no Periodic_Thread queued on them under
+// a partitioned criterion such as PLLF, and spreads sources among those by how
+// many each already takes. Sources move off a hart as soon as its first
+// periodic thread arrives, and are spread back onto it when its last one
+// leaves. If every hart is hard real-time, the least loaded one takes the
+// source.
+
+#ifndef __interrupt_h
+#define __interrupt_h
+
+#include <architecture.h>
+#include <machine.h>
+#include <process.h>
+#include <synchronizer.h>
+
+__BEGIN_SYS
+
+class Interrupt_Balancer
+{
+private:
+    static const unsigned int CPUS = Traits<Machine>::CPUS;
+
+public:
+    typedef IC::Interrupt_Id Interrupt_Id;
+
+public:
+    // Routes an external interrupt to the best hart for device work
+    static void steer(Interrupt_Id id);
+
+    // Stops managing an external interrupt (its affinity is left as is)
+    static void forget(Interrupt_Id id);
+
+    // Accounts for a hard real-time thread joining (or leaving) the partition of a hart
+    static void partition(unsigned int cpu, bool join);
+
+    static unsigned int hard_rt(unsigned int cpu) { return _hard_rt[cpu]; }
+    static unsigned int load(unsigned int cpu) { return _load[cpu]; }
+
+private:
+    static unsigned int best();
+    static void route(Interrupt_Id id, unsigned int cpu);
+
+    static bool lock()
+    {
+        bool enabled = CPU::int_enabled();
+        CPU::int_disable();
+        while (CPU::tsl(_locked))
+            ;
+        return enabled;
+    }
+
+    static void unlock(bool enabled)
+    {
+        _locked = false;
+        if (enabled)
+            CPU::int_enable();
+    }
+
+private:
+    static volatile bool _locked;
+    static unsigned int _hard_rt[CPUS];
+    static unsigned int _load[CPUS];
+    static unsigned char _cpu[IC::INTS]; // 1 + hart each steered interrupt is routed to, 0 if not steered
+};
+
+class Interrupt_Thread
+{
+public:
+    typedef IC::Interrupt_Id Interrupt_Id;
+    typedef IC::Interrupt_Handler Handler;
+    typedef Thread::Criterion Criterion;
+
+public:
+    Interrupt_Thread(Interrupt_Id id, Handler handler, const Criterion &criterion = Criterion())
+        : _id(id), _handler(handler), _previous(IC::int_vector(id)), _pending(0), _finishing(false)
+    {
+        db<Thread>(TRC) << "Interrupt_Thread(int=" << id << ",h=" << reinterpret_cast<void *>(handler) << ") => " << this << endl;
+
+        _thread = new Thread(Thread::Configuration(Thread::READY, criterion), &bottom_half, this);
+
+        _threads[id] = this;
+        IC::int_vector(id, &top_half);
+        if(Traits<IC>::balanced)
+            Interrupt_Balancer::steer(id);
+        IC::enable(id);
+    }
+
+    ~Interrupt_Thread()
+    {
+        db<Thread>(TRC) << "~Interrupt_Thread(this=" << this << ")" << endl;
+
+        IC::disable(_id);
+        if(Traits<IC>::balanced)
+            Interrupt_Balancer::forget(_id);
+        IC::int_vector(_id, _previous);
+        _threads[_id] = 0;
+
+        _finishing = true;
+        _pending.v();
+        _thread->join();
+        delete _thread;
+    }
+
+    Interrupt_Id id() const { return _id; }
+    Thread *thread() const { return _thread; }
+
+private:
+    static void top_half(Interrupt_Id id)
+    {
+        IC::disable(id);
+        _threads[id]->_pending.v();
+    }
+
+    static int bottom_half(Interrupt_Thread *it)
+    {
+        for (;;)
+        {
+            it->_pending.p();
+            if (it->_finishing)
+                break;
+            it->_handler(it->_id);
+            IC::enable(it->_id);
+        }
+        return 0;
+    }
+
+private:
+    Interrupt_Id _id;
+    Handler _handler;
+    Handler _previous;
+    Thread *_thread;
+    Semaphore _pending;
+    volatile bool _finishing;
+
+    static Interrupt_Thread *_threads[IC::INTS];
+};
+
+__END_SYS
+
+#endif
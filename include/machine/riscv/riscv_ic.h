@@ -86,21 +86,40 @@ public:
     static void disable() { for(Reg32 id = 1; id < IRQS; id++) disable(id); }
     static void disable(Reg32 id) { _disable(context(), id); }
 
+    // Enable bits of another hart's context, to route a source to it
+    static void enable(unsigned int cpu, Reg32 id) { _enable(context(cpu), id); }
+    static void disable(unsigned int cpu, Reg32 id) { _disable(context(cpu), id); }
+    static bool routed(unsigned int cpu, Reg32 id) { return enabled(context(cpu), id) & (1 << (id % 32)); }
+
     static Reg32 claim() {
-        if(!_claimed)
-            _claimed = _claim(context());
-        return _claimed;
+        if(!_claimed[CPU::id()])
+            _claimed[CPU::id()] = _claim(context());
+        return _claimed[CPU::id()];
     }
     static void complete(Reg32 id) {
-        if(id != _claimed)
+        if(_claimed[CPU::id()] && (id != _claimed[CPU::id()]))
             db<IC>(WRN) << "IC::complete(id=" << id << "): completing unclaimed interrupt!" << endl;
         _complete(context(), id);
-        _claimed = 0;
+        if(id == _claimed[CPU::id()])
+            _claimed[CPU::id()] = 0;
+    }
+
+    // Hands the claimed source over to the caller, who must complete() it, so that a nested interrupt can be claimed meanwhile
+    static Reg32 take() {
+        Reg32 id = claim();
+        _claimed[CPU::id()] = 0;
+        return id;
     }
 
     static Reg32 threshold() { return _threshold(context()); }
     static void threshold(Reg32 v) { _threshold(context(), v); }
 
+    // A handler that runs with interrupts enabled may be rescheduled on another hart, so whoever
+    // takes a source must capture the context at claim time and restore and complete on it
+    static unsigned int context() { return context(CPU::id()); }
+    static void threshold(unsigned int context, Reg32 v) { _threshold(context, v); }
+    static void complete(unsigned int context, Reg32 id) { _complete(context, id); }
+
     static Reg32 priority(Reg32 id) { return _priority(id); }
     static void priority(Reg32 id, Reg32 v) { _priority(id, v); }
 
@@ -120,13 +139,13 @@ private:
     static bool _pending(Reg32 id) { return reg(PENDING + (id >> 3)) & ~(1 << (id % 32)); }
 
     // SiFive-U has 9 contexts: Hart0 MAC, Hart1 MAC, Hart1 SUP, Hart2 MAC, Hart2 SUP, Hart3 MAC, Hart3 SUP, Hart4 MAC, Hart4 SUP
-    static unsigned int context() { return (Traits<Build>::MODEL == Traits<Build>::SiFive_U) ? (supervisor || ((CPU::id() + CPU_OFFSET) == 0)) + (CPU::id() + CPU_OFFSET) * 2 - 1 : 0; }
+    static unsigned int context(unsigned int cpu) { return (Traits<Build>::MODEL == Traits<Build>::SiFive_U) ? (supervisor || ((cpu + CPU_OFFSET) == 0)) + (cpu + CPU_OFFSET) * 2 - 1 : 0; }
 
     static volatile Reg32 & reg(unsigned int o) { return reinterpret_cast<volatile CPU::Reg32 *>(Memory_Map::PLIC_BASE)[o / sizeof(CPU::Reg32)]; }
     static volatile Reg32 & enabled(Reg32 context, Reg32 id) { return reg(ENABLED + context * 0x80 + (id >> 3)); } // if contexto ranges from 0 to 8
 
 private:
-    static Reg32 _claimed;
+    static Reg32 _claimed[Traits<Build>::CPUS];
 };
 
 class IC: private IC_Common, private CLINT, private PLIC
@@ -138,11 +157,13 @@ private:
     typedef CPU::Reg Reg;
 
     static const bool supervisor = Traits<Machine>::supervisor;
+    static const bool nested = Traits<IC>::nested;
 
 public:
     static const unsigned int EXCS = CPU::EXCEPTIONS;
     static const unsigned int IRQS = CLINT::IRQS + PLIC::IRQS;
-    static const unsigned int INTS = EXCS + IRQS;
+    static const unsigned int IPIS = 1; // software IPIs multiplexed over the software interrupt (see ipi())
+    static const unsigned int INTS = EXCS + IRQS + IPIS;
 
     using IC_Common::Interrupt_Id;
     using IC_Common::Interrupt_Handler;
@@ -177,7 +198,9 @@ public:
         INT_UART1       = HARD_INT + PLIC::IRQ_UART1,
         INT_UART2       = HARD_INT + PLIC::IRQ_UART2,
         INT_UART3       = HARD_INT + PLIC::IRQ_UART3,
-        INT_WDOG        = HARD_INT + PLIC::IRQ_WDOG
+        INT_WDOG        = HARD_INT + PLIC::IRQ_WDOG,
+        SOFT_INT        = EXCS + IRQS,
+        INT_SHOOTDOWN   = SOFT_INT
     };
 
 public:
@@ -209,10 +232,13 @@ public:
             CPU::ies(CPU::TI);
         else if(i == INT_PLIC)
             CPU::ies(CPU::EI);
-        else if(i > HARD_INT) {
+        else if((i > HARD_INT) && (i < SOFT_INT)) {
             i = int2irq(i);
-            PLIC::enable(i);
-            PLIC::priority(i, 1);
+            if(_affinity[i])
+                route(i, _affinity[i]);
+            else if(!routed(i))
+                PLIC::enable(i);
+            PLIC::priority(i, _priority[i]);
         }
     }
 
@@ -231,16 +257,44 @@ public:
             CPU::iec(CPU::TI);
         else if(i == INT_PLIC)
             CPU::iec(CPU::EI);
-        else if(i > HARD_INT) {
-             i = int2irq(i);
-             PLIC::disable(i);
-             PLIC::priority(i, 0);
-         }
-      }
+        else if((i > HARD_INT) && (i < SOFT_INT)) {
+            // Sources are masked by priority only: the PLIC ignores the completion of a source whose
+            // enable bit is clear, so clearing it while the source is claimed (e.g. from its own handler)
+            // would leave it stuck. The routing is kept and enable() restores the priority.
+            PLIC::priority(int2irq(i), 0);
+        }
+    }
 
+    // Priority (1 = lowest to 7 = highest) of an external interrupt, kept across disable() and enable().
+    // With Traits<IC>::nested, only higher priorities (and the timer and IPIs) preempt a running handler.
     static void priority(Interrupt_Id i, unsigned int p) {
-        assert((HARD_INT < i) && (i < INTS) && (p <= 7));
-        PLIC::priority(int2irq(i), p);
+        db<IC>(TRC) << "IC::priority(int=" << i << ",p=" << p << ")" << endl;
+        assert((HARD_INT < i) && (i < SOFT_INT) && (p >= 1) && (p <= 7));
+        i = int2irq(i);
+        _priority[i] = p;
+        if(PLIC::priority(i)) // enabled
+            PLIC::priority(i, p);
+    }
+
+    static unsigned int priority(Interrupt_Id i) {
+        assert((HARD_INT < i) && (i < SOFT_INT));
+        return _priority[int2irq(i)];
+    }
+
+    // Harts (bit n for CPU n) an external interrupt is routed to, kept across disable() and enable().
+    // An empty mask, the default, routes it to whichever hart enables it.
+    static void affinity(Interrupt_Id i, unsigned long cpus) {
+        db<IC>(TRC) << "IC::affinity(int=" << i << ",cpus=" << hex << cpus << ")" << endl;
+        assert((HARD_INT < i) && (i < SOFT_INT));
+        i = int2irq(i);
+        _affinity[i] = cpus;
+        if(PLIC::priority(i)) // enabled
+            route(i, cpus ? cpus : 1UL << CPU::id());
+    }
+
+    static unsigned long affinity(Interrupt_Id i) {
+        assert((HARD_INT < i) && (i < SOFT_INT));
+        return _affinity[int2irq(i)];
     }
 
     static Interrupt_Id int_id() {
@@ -255,28 +309,67 @@ public:
     static Interrupt_Id irq2int(Interrupt_Id i) { return ((i == IRQ_PLIC) ? claim() + CLINT::IRQS : i) + EXCS; }
     static Interrupt_Id int2irq(Interrupt_Id i) { return  ((i > HARD_INT) ? i - CLINT::IRQS : i) - EXCS; }
 
+    // There is a single software interrupt per hart, so the IPI being sent is recorded
+    // in a per-hart pending mask (bit 0 for INT_RESCHEDULER, bit 1 + n for SOFT_INT + n)
+    // that dispatch() consumes when the software interrupt arrives
     static void ipi(unsigned int cpu, Interrupt_Id i) {
         db<IC>(TRC) << "IC::ipi(cpu=" << cpu << ",int=" << i << ")" << endl;
         assert(i < INTS);
+        Reg bit = (i >= SOFT_INT) ? 1UL << (i - SOFT_INT + 1) : 1;
+        Reg old;
+        do
+            old = _ipis[cpu];
+        while(CPU::cas(_ipis[cpu], old, old | bit) != old);
+        CPU::fence();
         msip(cpu) = 1;
     }
 
     static void ipi_eoi(Interrupt_Id i) { msip(CPU::id()) = 0; }
 
 private:
+    typedef void (* Entry)();
+
     static void dispatch();
+    static void timer_dispatch();
+    static void soft_dispatch();
+    static void plic_dispatch(Interrupt_Id id);
 
     // Logical handlers
     static void int_not(Interrupt_Id i);
     static void exception(Interrupt_Id i);
 
-    // Physical handler
+    // Physical handlers
     static void entry() __attribute((naked, aligned(4)));
+    static void timer_entry() __attribute((naked, aligned(4)));
+    static void soft_entry() __attribute((naked, aligned(4)));
+
+    // Vectored-mode table: exceptions (slot 0) and external interrupts take entry() with the full context,
+    // while the timer and software interrupts (the scheduler tick and IPIs) take lean entries
+    static void vector() __attribute((naked, aligned(64)));
+    static constexpr Entry vector_entry(Reg slot) { return (slot == IRQ_TIMER) ? &timer_entry : (slot == IRQ_SOFT) ? &soft_entry : &entry; }
+
+    static bool routed(Interrupt_Id irq) {
+        for(unsigned int cpu = 0; cpu < CPU::cores(); cpu++)
+            if(PLIC::routed(cpu, irq))
+                return true;
+        return false;
+    }
+
+    static void route(Interrupt_Id irq, unsigned long cpus) {
+        for(unsigned int cpu = 0; cpu < CPU::cores(); cpu++)
+            if(cpus & (1UL << cpu))
+                PLIC::enable(cpu, irq);
+            else
+                PLIC::disable(cpu, irq);
+    }
 
     static void init();
 
 private:
     static Interrupt_Handler _int_vector[INTS];
+    static volatile Reg _ipis[Traits<Build>::CPUS];
+    static unsigned char _priority[PLIC::IRQS];
+    static unsigned long _affinity[PLIC::IRQS];
 };
 
 __END_SYS
@@ -103,9 +103,14 @@ public:
     void handler(Handler handler) { _handler = handler; }
 
 private:
+    // With Sstc, supervisor mode programs stimecmp itself (which also clears STIP);
+    // otherwise MTIMECMP is used and _int_m2s forwards MTI as STI
     static void config(Hertz frequency) 
 	{ 
-		mtimecmp(mtime() + (CLOCK / frequency)); 
+		if (_sstc)
+			CPU::stimecmp(mtime() + (CLOCK / frequency));
+		else
+			mtimecmp(mtime() + (CLOCK / frequency)); 
 	}
 
     static void int_handler(Interrupt_Id i);
@@ -120,6 +125,7 @@ protected:
     Handler _handler;
 
     static Timer *_channels[CHANNELS];
+    static bool _sstc;
 };
 
 // Timer used by Thread::Scheduler
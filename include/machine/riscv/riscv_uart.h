@@ -4,6 +4,7 @@
 #define __riscv_uart_h
 
 #include <architecture/cpu.h>
+#include <machine/ic.h>
 #include <machine/uart.h>
 #include <system/memory_map.h>
 
@@ -52,7 +53,7 @@ public:
 
     void config(unsigned int baud_rate, unsigned int data_bits, unsigned int parity, unsigned int stop_bits) {
         reg(TXCTRL) = 1 << 16 | stop_bits | TXEN; // TXCNT = 1, STOP = (stop_bits - 1) << 1
-        reg(RXCTRL) = 1 << 16 | RXEN; // RXCNT = 1
+        reg(RXCTRL) = RXEN; // RXCNT = 0, so RXWM rises with the first byte received
         reg(DIV) = ((CLOCK / baud_rate) - 1) & 0xffff;
     }
 
@@ -74,7 +75,7 @@ public:
     bool txd_ok() { return !(reg(TXDATA) & FULL); }
 
     void int_enable(bool receive = true, bool transmit = true, bool line = true, bool modem = true) {
-         reg(IE) = (receive << 1) | transmit;
+         reg(IE) = reg(IE) | (receive << 1) | transmit;
     }
     void int_disable(bool receive = true, bool transmit = true, bool line = true, bool modem = true) {
          reg(IE) = reg(IE) & ~((receive << 1) | transmit);
@@ -221,6 +222,8 @@ private:
     static const unsigned int DATA_BITS = Traits<UART>::DEF_DATA_BITS;
     static const unsigned int PARITY = Traits<UART>::DEF_PARITY;
     static const unsigned int STOP_BITS = Traits<UART>::DEF_STOP_BITS;
+    static const unsigned int TX_BUFFER_SIZE = Traits<UART>::TX_BUFFER_SIZE;
+    static const unsigned int RX_BUFFER_SIZE = Traits<UART>::RX_BUFFER_SIZE;
 
     typedef IF<(Traits<Build>::MODEL == Traits<Build>::SiFive_E) || (Traits<Build>::MODEL == Traits<Build>::SiFive_U), SiFive_UART, NS16500A>::Result Engine;
 
@@ -235,28 +238,88 @@ public:
 
     using Engine::config;
 
-    char get() { while(!rxd_ok()); return rxd(); }
-    void put(char c) { while(!txd_ok()); txd(c); }
+    char get() {
+        if(RX_BUFFER_SIZE && _buffered)
+            return dequeue();
+        else {
+            while(!rxd_ok());
+            return rxd();
+        }
+    }
+    void put(char c) {
+        if(TX_BUFFER_SIZE && _buffered)
+            enqueue(c);
+        else {
+            while(!txd_ok());
+            txd(c);
+        }
+    }
 
     int read(char * data, unsigned int max_size) {
         for(unsigned int i = 0; i < max_size; i++)
             data[i] = get();
-        return 0;
+        return max_size;
     }
     int write(const char * data, unsigned int size) {
         for(unsigned int i = 0; i < size; i++)
             put(data[i]);
-        return 0;
+        return size;
     }
 
-    bool ready_to_get() { return rxd_ok(); }
+    // Reads a line of at most max - 1 characters terminated by CR or LF (which is not stored), honoring backspace
+    // and returning the length of the null-terminated line; echo sends what is typed back to the other end
+    int readline(char * line, unsigned int max, bool echo = false);
+
+    bool ready_to_get() { return (RX_BUFFER_SIZE && _buffered) ? (_rx_head != _rx_tail) : rxd_ok(); }
     bool ready_to_put() { return txd_ok(); }
 
     using Engine::int_enable;
     using Engine::int_disable;
-    using Engine::flush;
+
+    // Drains the transmit buffer by polling (it works with interrupts disabled, e.g. on a panic) and waits for the FIFO to empty
+    void flush();
+
+    // With Traits<UART>::TX_BUFFER_SIZE, put() queues characters to be sent by the TX interrupt instead of waiting on the FIFO.
+    // With Traits<UART>::RX_BUFFER_SIZE, the RX interrupt stores what arrives and get() sleeps on a Semaphore until there is data.
+    void buffered(bool enable);
+    bool buffered() const { return _buffered; }
+
+    // Characters dropped because the receive buffer was full
+    unsigned long overruns() const { return _rx_overruns; }
 
     void power(const Power_Mode & mode);
+
+private:
+    void enqueue(char c);
+    char dequeue();
+
+    static void int_handler(IC::Interrupt_Id i);
+
+    static bool lock() {
+        bool enabled = CPU::int_enabled();
+        CPU::int_disable();
+        while(CPU::tsl(_locked));
+        return enabled;
+    }
+
+    static void unlock(bool enabled) {
+        _locked = false;
+        if(enabled)
+            CPU::int_enable();
+    }
+
+private:
+    static UART * _owner;
+    static volatile bool _buffered;
+    static volatile bool _locked;
+    static volatile unsigned int _tx_head;
+    static volatile unsigned int _tx_tail;
+    static char _tx[TX_BUFFER_SIZE ? TX_BUFFER_SIZE : 1];
+    static volatile unsigned int _rx_head;
+    static volatile unsigned int _rx_tail;
+    static volatile unsigned long _rx_overruns;
+    static char _rx[RX_BUFFER_SIZE ? RX_BUFFER_SIZE : 1];
+    static Semaphore _rx_ready;
 };
 
 __END_SYS
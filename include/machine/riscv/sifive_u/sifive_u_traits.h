@@ -70,6 +70,10 @@ struct Traits<IC> : public Traits<Machine_Common>
 {
     static const bool debugged = hysterically_debugged;
 
+    static const bool vectored = true; // [m|s]tvec in vectored mode, with lean entries for the timer and IPIs
+    static const bool nested = false;  // external handlers run with interrupts enabled and the PLIC threshold at their own priority
+    static const bool balanced = false; // route Interrupt_Thread sources away from harts running hard real-time partitions
+
     static const unsigned int PLIC_IRQS = 54; // IRQ0 is used by PLIC to signalize that there is no interrupt being serviced or pending
 
     struct Interrupt_Source : public _SYS::Interrupt_Source
@@ -118,6 +122,9 @@ struct Traits<UART> : public Traits<Machine_Common>
     static const unsigned int DEF_DATA_BITS = 8;
     static const unsigned int DEF_PARITY = 0; // none
     static const unsigned int DEF_STOP_BITS = 1;
+
+    static const unsigned int TX_BUFFER_SIZE = 2048; // output queued for the TX interrupt (0 for polled output only)
+    static const unsigned int RX_BUFFER_SIZE = 256;  // input stored by the RX interrupt (0 for polled input only)
 };
 
 template <>
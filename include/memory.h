@@ -38,10 +38,13 @@ public:
     typedef CPU::Phy_Addr Phy_Addr;
     typedef CPU::Log_Addr Log_Addr;
     typedef MMU::Flags Flags;
+    typedef MMU::Color_Set Color_Set;
 
 public:
-    Segment(unsigned long bytes, Flags flags = Flags::APPD);
+    explicit Segment(unsigned long bytes, Flags flags = Flags::APPD); // explicit, or unsigned values would be taken for a Segment to clone
+    Segment(unsigned long bytes, Flags flags, const Color_Set & colors);
     Segment(Phy_Addr phy_addr, unsigned long bytes, Flags flags);
+    Segment(const Segment & seg, bool copy_on_write); // clone
     ~Segment();
 
     unsigned long size() const;
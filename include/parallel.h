@@ -0,0 +1,235 @@
+// EPOS Fork/Join Task Pool Declarations
+
+// A Fork_Join_Pool runs data-parallel loops on a fixed set of worker threads,
+// one pinned to each core. parallel_for() splits [begin, end) into chunks of at
+// most "grain" iterations and deals them round-robin into per-worker deques.
+// Workers pop chunks from the bottom of their own deque and, once it is empty,
+// steal from the top of the others', so an unbalanced split evens out without
+// creating a thread per task. The calling thread also executes chunks while it
+// waits, and it only blocks when nothing is left to steal and some chunks are
+// still running on the workers.
+// parallel_for() must not be called from inside a chunk.
+
+#ifndef __parallel_h
+#define __parallel_h
+
+#include <architecture.h>
+#include <process.h>
+#include <synchronizer.h>
+
+__BEGIN_SYS
+
+class Fork_Join_Pool
+{
+private:
+    static const unsigned int WORKERS = Traits<Build>::CPUS;
+    static const unsigned int DEQUE_SIZE = 64;
+
+    typedef Thread::Criterion Criterion;
+
+public:
+    typedef void (Body)(long begin, long end, void *arg);
+
+private:
+    struct Task
+    {
+        Body *body;
+        void *arg;
+        long begin;
+        long end;
+        volatile long *pending;
+        Semaphore *done;
+    };
+
+    // Bounded deque guarded by a spin lock taken with interrupts disabled,
+    // so a holder is never preempted by a thief running on the same core
+    class Deque
+    {
+    public:
+        Deque() : _locked(false), _top(0), _bottom(0) {}
+
+        bool push(const Task &t)
+        {
+            bool ok = false;
+            bool e = acquire();
+            if (_bottom - _top < DEQUE_SIZE)
+            {
+                _task[_bottom++ % DEQUE_SIZE] = t;
+                ok = true;
+            }
+            release(e);
+            return ok;
+        }
+
+        // Owner side, LIFO
+        bool pop(Task *t)
+        {
+            bool ok = false;
+            bool e = acquire();
+            if (_bottom != _top)
+            {
+                *t = _task[--_bottom % DEQUE_SIZE];
+                ok = true;
+            }
+            release(e);
+            return ok;
+        }
+
+        // Thief side, FIFO
+        bool steal(Task *t)
+        {
+            bool ok = false;
+            bool e = acquire();
+            if (_bottom != _top)
+            {
+                *t = _task[_top++ % DEQUE_SIZE];
+                ok = true;
+            }
+            release(e);
+            return ok;
+        }
+
+    private:
+        bool acquire()
+        {
+            bool enabled = CPU::int_enabled();
+            CPU::int_disable();
+            while (CPU::tsl(_locked))
+                ;
+            return enabled;
+        }
+
+        void release(bool enabled)
+        {
+            _locked = false;
+            if (enabled)
+                CPU::int_enable();
+        }
+
+    private:
+        volatile bool _locked;
+        unsigned long _top;
+        unsigned long _bottom;
+        Task _task[DEQUE_SIZE];
+    };
+
+public:
+    Fork_Join_Pool(const Criterion &criterion = Criterion()) : _work(0), _finishing(false), _next(0)
+    {
+        db<Thread>(TRC) << "Fork_Join_Pool() => " << this << endl;
+
+        _workers = (CPU::cores() < WORKERS) ? CPU::cores() : WORKERS;
+        for (unsigned int i = 0; i < _workers; i++)
+        {
+            Criterion c = criterion;
+            c.queue(i); // pin to core i under partitioned criteria
+            _worker[i] = new Thread(Thread::Configuration(Thread::READY, c), &worker, this, i);
+        }
+    }
+
+    ~Fork_Join_Pool()
+    {
+        db<Thread>(TRC) << "~Fork_Join_Pool(this=" << this << ")" << endl;
+
+        _finishing = true;
+        for (unsigned int i = 0; i < _workers; i++)
+            _work.v();
+        for (unsigned int i = 0; i < _workers; i++)
+        {
+            _worker[i]->join();
+            delete _worker[i];
+        }
+    }
+
+    unsigned int workers() const { return _workers; }
+
+    void parallel_for(long begin, long end, long grain, Body *body, void *arg = 0)
+    {
+        db<Thread>(TRC) << "Fork_Join_Pool::parallel_for(b=" << begin << ",e=" << end << ",g=" << grain << ")" << endl;
+
+        if (begin >= end)
+            return;
+        if (grain < 1)
+            grain = 1;
+
+        volatile long pending = (end - begin + grain - 1) / grain;
+        Semaphore done(0);
+
+        unsigned long chunks = pending;
+        for (long b = begin; b < end; b += grain)
+        {
+            Task t = {body, arg, b, (end - b > grain) ? b + grain : end, &pending, &done};
+            if (!_deque[CPU::finc(_next) % _workers].push(t)) // other threads may be dealing chunks too
+                run(t); // all deques full: execute it right away
+        }
+
+        for (unsigned long i = 0; (i < chunks) && (i < _workers); i++)
+            _work.v();
+
+        // Help until nothing is left to steal, then wait for the chunks in flight
+        Task t;
+        while (grab(CPU::id() % _workers, &t))
+            run(t);
+        done.p();
+    }
+
+    // Runs f(i) for every i in [begin, end); F is any object with operator()(long)
+    template <typename F>
+    void parallel_for(long begin, long end, long grain, F &f)
+    {
+        parallel_for(begin, end, grain, &call<F>, &f);
+    }
+
+private:
+    template <typename F>
+    static void call(long begin, long end, void *arg)
+    {
+        F &f = *reinterpret_cast<F *>(arg);
+        for (long i = begin; i < end; i++)
+            f(i);
+    }
+
+    static void run(const Task &t)
+    {
+        t.body(t.begin, t.end, t.arg);
+        if (CPU::fdec(*t.pending) == 1)
+            t.done->v();
+    }
+
+    // Own deque first, then steal from the others starting at the next one
+    bool grab(unsigned int home, Task *t)
+    {
+        if (_deque[home].pop(t))
+            return true;
+        for (unsigned int i = 1; i < _workers; i++)
+            if (_deque[(home + i) % _workers].steal(t))
+                return true;
+        return false;
+    }
+
+    static int worker(Fork_Join_Pool *pool, unsigned int id)
+    {
+        Task t;
+        for (;;)
+        {
+            pool->_work.p();
+            if (pool->_finishing)
+                break;
+            while (pool->grab(id, &t))
+                run(t);
+        }
+        return 0;
+    }
+
+private:
+    unsigned int _workers;
+    Thread *_worker[WORKERS];
+    Deque _deque[WORKERS];
+    Semaphore _work;
+    volatile bool _finishing;
+    volatile unsigned long _next;
+};
+
+__END_SYS
+
+#endif
@@ -34,6 +34,7 @@ class Thread
     friend void ::_lock_heap();   // for lock()
     friend void ::_unlock_heap(); // for unlock()
     friend class CpuLookupTable;
+    friend class Mutex;               // for _cpu_lookup_table (adaptive spinning)
 
 protected:
     static const bool preemptive = Traits<Thread>::Criterion::preemptive;
@@ -73,16 +74,21 @@ public:
     // Thread Queue
     typedef Ordered_Queue<Thread, Criterion, Scheduler<Thread>::Element> Queue;
 
+    // Page colors (see MMU::Color_Set)
+    typedef MMU::Color_Set Color_Set;
+
     // Thread Configuration
+    // "colors" confines the thread's stack to those page colors (the default, empty set leaves it on the uncolored heap)
     struct Configuration
     {
         Configuration(State s = READY, Criterion c = NORMAL,
-                      unsigned int ss = STACK_SIZE)
-            : state(s), criterion(c), stack_size(ss) {}
+                      unsigned int ss = STACK_SIZE, const Color_Set &cs = Color_Set())
+            : state(s), criterion(c), stack_size(ss), colors(cs) {}
 
         State state;
         Criterion criterion;
         unsigned int stack_size;
+        Color_Set colors;
     };
 
 public:
@@ -93,6 +99,9 @@ public:
     ~Thread();
 
     const volatile State &state() const { return _state; }
+
+    // Page colors for memory allocated on behalf of this thread, e.g. Segment(bytes, flags, Thread::self()->colors())
+    const Color_Set &colors() const { return _colors; }
     Criterion &criterion() { return const_cast<Criterion &>(_link.rank()); }
     volatile Criterion::Statistics &statistics() { return criterion().statistics(); }
 
@@ -146,7 +155,7 @@ public:
     static void exit(int status = 0);
 
 protected:
-    void constructor_prologue(unsigned int stack_size);
+    void constructor_prologue(unsigned int stack_size, const Color_Set &colors = Color_Set());
     void constructor_epilogue(Log_Addr entry, unsigned int stack_size);
 
     Queue::Element *link() { return &_link; }
@@ -216,6 +225,9 @@ private:
 
 protected:
     char *_stack;
+    Segment *_stack_segment; // only for stacks confined to page colors
+    MMU::Page_Directory *_stack_pd; // address space _stack_segment is attached to
+    Color_Set _colors;
     Context *volatile _context;
 
     volatile State _state;
@@ -258,7 +270,7 @@ inline Thread::Thread(Configuration conf, int (*entry)(Tn...), Tn... an)
 {
     db<Thread>(WRN) << "construtor da Thread\n"
                     << endl;
-    constructor_prologue(conf.stack_size);
+    constructor_prologue(conf.stack_size, conf.colors);
     _context = CPU::init_stack(0, _stack + conf.stack_size, &__exit, entry, an...);
     constructor_epilogue(entry, conf.stack_size);
 }
@@ -308,7 +320,7 @@ class CpuLookupTable
     typedef Traits<Thread>::Criterion Criterion;
 
 private:
-    Thread * _running_thread_by_core[Traits<Build>::CPUS];
+    Thread * volatile _running_thread_by_core[Traits<Build>::CPUS]; // read by Mutex::spin() on other cores without the thread lock
 	bool _already_dispatched[Traits<Build>::CPUS];
 
 public:
@@ -411,6 +423,18 @@ public:
         return chosen;
     }
 
+    /* Tells whether `thread` is currently running on some core.
+     * This is read without holding the thread lock, so the answer is only a hint;
+     * it is used by the adaptive Mutex to decide between spinning and sleeping. */
+    bool running(Thread *thread)
+    {
+        for (unsigned int i = 0; i < CPU::cores(); i++)
+            if (_running_thread_by_core[i] == thread)
+                return true;
+
+        return false;
+    }
+
     /* Just resets the entry corresponting to the `cpu_id` by setting it to nullptr.
      * This ensures that this core will easily be picked as a target for interrupt,
      * when it enters Thread::idle(). */
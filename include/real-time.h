@@ -9,6 +9,7 @@
 #include <time.h>
 #include <process.h>
 #include <synchronizer.h>
+#include <interrupt.h>
 
 __BEGIN_SYS
 
@@ -68,8 +69,9 @@ public:
 					  Microsecond a = NOW,
 					  const unsigned int n = INFINITE,
 					  State s = READY,
-					  unsigned int ss = STACK_SIZE)
-			: Thread::Configuration(s, Criterion(p, d, c), ss),
+					  unsigned int ss = STACK_SIZE,
+					  const Color_Set & cs = Color_Set())
+			: Thread::Configuration(s, Criterion(p, d, c), ss, cs),
 									activation(a),
 									times(n) {}
 
@@ -82,14 +84,16 @@ public:
     Periodic_Thread(Microsecond p, int (* entry)(Tn ...), Tn ... an)
     : Thread(Thread::Configuration(SUSPENDED, Criterion(p)), entry, an ...),
       _semaphore(0), _handler(&_semaphore, this), _alarm(p, &_handler, INFINITE) {
+        partition(true);
         resume();
         criterion().handle(Criterion::JOB_RELEASE);
     }
 
     template<typename ... Tn>
     Periodic_Thread(Configuration conf, int (* entry)(Tn ...), Tn ... an)
-    : Thread(Thread::Configuration(SUSPENDED, conf.criterion, conf.stack_size), entry, an ...),
+    : Thread(Thread::Configuration(SUSPENDED, conf.criterion, conf.stack_size, conf.colors), entry, an ...),
       _semaphore(0), _handler(&_semaphore, this), _alarm(conf.criterion.period(), &_handler, conf.times) {
+        partition(true);
         if((conf.state == READY) || (conf.state == RUNNING)) {
             _state = SUSPENDED;
             resume();
@@ -98,6 +102,8 @@ public:
             _state = conf.state;
     }
 
+    ~Periodic_Thread() { partition(false); }
+
     Microsecond period() const { return _alarm.period(); }
     void period(Microsecond p) { _alarm.period(p); }
 
@@ -114,6 +120,13 @@ public:
         return t->_alarm.times();
     }
 
+private:
+    // Tells the Interrupt_Balancer that this thread's partition runs hard real-time work
+    void partition(bool join) {
+        if(Traits<IC>::balanced && (Criterion::QUEUES > 1))
+            Interrupt_Balancer::partition(criterion().queue(), join);
+    }
+
 protected:
     Semaphore _semaphore;
     Handler _handler;
@@ -4,6 +4,7 @@
 #include <architecture.h>
 #include <utility/handler.h>
 #include <process.h>
+#include <utility/ring.h>
 
 __BEGIN_SYS
 
@@ -284,6 +285,20 @@ protected:
         Thread::wakeup_all(&_waiting);
     }
 
+    // Variants for synchronizers that keep more than one waiting queue
+    void sleep(Sync_Queue *q)
+    {
+        Thread::sleep(q);
+    }
+    void wakeup(Sync_Queue *q)
+    {
+        Thread::wakeup(q);
+    }
+    void wakeup_all(Sync_Queue *q)
+    {
+        Thread::wakeup_all(q);
+    }
+
 public:
     int getMostUrgentPriority()
     {
@@ -335,8 +350,14 @@ public:
 };
 
 // Mutex class
+// On multicore builds, lock() first spins for up to Traits<Synchronizer>::SPIN_LIMIT
+// microseconds while the owner is running on another core, and only sleeps if it remains busy.
 class Mutex : protected Synchronizer_Common
 {
+private:
+    static const bool adaptive = Traits<Machine>::multi && Traits<Synchronizer>::SPIN_LIMIT;
+    static const unsigned int SPIN_LIMIT = Traits<Synchronizer>::SPIN_LIMIT; // us
+
 public:
     Mutex();
     ~Mutex();
@@ -344,8 +365,12 @@ public:
     void lock();
     void unlock();
 
+private:
+    void spin();
+
 private:
     volatile bool _locked;
+    Thread * volatile _owner;
 };
 
 // Semaphore class
@@ -363,6 +388,34 @@ private:
     bool producer;
 };
 
+// Readers-writer lock
+// Readers share the lock, writers hold it exclusively. Writers are preferred:
+// once a writer is waiting, new readers block until it is served. Both waiting
+// queues are Thread::Queues, so waiters are released in Criterion order.
+class RW_Lock : protected Synchronizer_Common
+{
+public:
+    RW_Lock();
+    ~RW_Lock();
+
+    void read_lock();
+    void read_unlock();
+
+    void write_lock();
+    void write_unlock();
+
+private:
+    void wait(Sync_Queue *q);
+    void acquired();
+    void released();
+
+private:
+    volatile long _readers;
+    volatile bool _writing;
+    long _waiting_readers;
+    Sync_Queue _readers_waiting; // writers wait on Synchronizer_Common::_waiting
+};
+
 // This is actually no Condition Variable
 // check http://www.cs.duke.edu/courses/spring01/cps110/slides/sem/sld002.htm
 class Condition : protected Synchronizer_Common
@@ -376,6 +429,108 @@ public:
     void broadcast();
 };
 
+// Blocking wrapper for the lock-free rings (see utility/ring.h)
+// The fast path is the lock-free ring alone. A Semaphore is only touched when a
+// side actually has to wait, i.e. when the ring goes from empty to non-empty
+// with consumers asleep or from full to non-full with producers asleep.
+// Sleepers register in a counter before re-checking the ring. The other side
+// claims one registration with CPU::cas per v(), so wakeups are never lost, and
+// a sleeper that finds room on its re-check absorbs any v() already issued for it.
+template <typename Ring>
+class Blocking_Ring
+{
+public:
+    typedef typename Ring::Object_Type Object_Type;
+
+public:
+    Blocking_Ring() : _not_empty(0), _not_full(0), _consumers(0), _producers(0) {}
+
+    bool empty() const { return _ring.empty(); }
+    bool full() const { return _ring.full(); }
+    unsigned long size() const { return _ring.size(); }
+
+    bool try_insert(const Object_Type &o)
+    {
+        if (!_ring.insert(o))
+            return false;
+        notify(_consumers, _not_empty);
+        return true;
+    }
+
+    bool try_remove(Object_Type *o)
+    {
+        if (!_ring.remove(o))
+            return false;
+        notify(_producers, _not_full);
+        return true;
+    }
+
+    void insert(const Object_Type &o)
+    {
+        while (!_ring.insert(o))
+        {
+            CPU::finc(_producers);
+            CPU::fence();
+            if (_ring.insert(o))
+            {
+                withdraw(_producers, _not_full);
+                break;
+            }
+            _not_full.p();
+        }
+        notify(_consumers, _not_empty);
+    }
+
+    Object_Type remove()
+    {
+        Object_Type o;
+        while (!_ring.remove(&o))
+        {
+            CPU::finc(_consumers);
+            CPU::fence();
+            if (_ring.remove(&o))
+            {
+                withdraw(_consumers, _not_empty);
+                break;
+            }
+            _not_empty.p();
+        }
+        notify(_producers, _not_full);
+        return o;
+    }
+
+private:
+    // Takes one registration out of sleepers, if there is any
+    static bool claim(volatile long &sleepers)
+    {
+        for (long n = sleepers; n > 0; n = sleepers)
+            if (CPU::cas(sleepers, n, n - 1) == n)
+                return true;
+        return false;
+    }
+
+    static void notify(volatile long &sleepers, Semaphore &s)
+    {
+        CPU::fence();
+        if (claim(sleepers))
+            s.v();
+    }
+
+    // A registered thread that did not need to sleep after all
+    static void withdraw(volatile long &sleepers, Semaphore &s)
+    {
+        if (!claim(sleepers))
+            s.p(); // the other side already claimed us and owes (or issued) a v()
+    }
+
+private:
+    Ring _ring;
+    Semaphore _not_empty;
+    Semaphore _not_full;
+    volatile long _consumers;
+    volatile long _producers;
+};
+
 // An event handler that triggers a mutex (see handler.h)
 class Mutex_Handler : public Handler
 {
@@ -131,6 +131,7 @@ class Synchronizer_Common;
 class Mutex;
 class Semaphore;
 class Condition;
+class RW_Lock;
 
 class Time;
 class Clock;
@@ -0,0 +1,226 @@
+// EPOS Buddy Allocator Utility Declarations
+
+// Buddy_Allocator manages a fixed region [BASE, BASE + SIZE) in units of UNIT
+// bytes, which is usually a page frame. Free memory is kept as power-of-two
+// blocks that are aligned to their own size relative to BASE, with one free list
+// per order. Allocation takes the smallest block that fits and splits it. Freeing
+// a block merges it with its buddy for as long as the buddy is also free. Both
+// operations cost O(ORDERS).
+// Requests need not be powers of two. alloc(n) gives back the unused tail of the
+// block it takes, and free(addr, n) accepts any run of units, including part of
+// an earlier allocation, by splitting it into maximal aligned blocks. claim()
+// takes a given run (e.g. the units right after an allocation, to grow it in
+// place) out of whichever free blocks hold it.
+// The free-list links and the block order are stored in the first bytes of
+// each free block. Addresses are handed to Translation::log() before being
+// dereferenced, so a physical frame allocator can keep working on physical
+// addresses. A bitmap with one bit per unit marks the units that start a free
+// block, which lets free() check whether a buddy is free without touching
+// allocated memory.
+
+#ifndef __buddy_h
+#define __buddy_h
+
+#include <utility/ostream.h>
+#include "bitmap.h"
+
+__BEGIN_UTIL
+
+struct Identity_Translation
+{
+    static void * log(unsigned long addr) { return reinterpret_cast<void *>(addr); }
+};
+
+template<unsigned long UNIT, unsigned long BASE, unsigned long SIZE, typename Translation = Identity_Translation>
+class Buddy_Allocator
+{
+private:
+    static constexpr unsigned int log2(unsigned long n) { return (n <= 1) ? 0 : 1 + log2(n >> 1); }
+
+public:
+    static const unsigned long UNITS = SIZE / UNIT;
+    static const unsigned int ORDERS = log2(UNITS) + 1;
+
+private:
+    struct Block {
+        Block * prev;
+        Block * next;
+        unsigned long addr;
+        unsigned int order;
+    };
+
+public:
+    Buddy_Allocator(): _units(0) {
+        for(unsigned int i = 0; i < ORDERS; i++) {
+            _list[i] = 0;
+            _blocks[i] = 0;
+        }
+    }
+
+    // Returns the address of n contiguous units, or 0 if there is no block large enough
+    unsigned long alloc(unsigned long n) {
+        if(!n || (n > UNITS))
+            return 0;
+
+        unsigned int order = log2(n);
+        if((1UL << order) < n)
+            order++;
+
+        unsigned int o = order;
+        while((o < ORDERS) && !_list[o])
+            o++;
+        if(o >= ORDERS)
+            return 0;
+
+        Block * b = _list[o];
+        unlink(b, o);
+        unsigned long addr = b->addr;
+        _units -= 1UL << order; // the split-off halves below stay free
+
+        // Split down to the requested order, keeping the lower halves
+        while(o > order) {
+            o--;
+            link(addr + (UNIT << o), o);
+        }
+
+        // Give back whatever the request did not need
+        if((1UL << order) > n)
+            free(addr + n * UNIT, (1UL << order) - n);
+
+        return addr;
+    }
+
+    void free(unsigned long addr, unsigned long n) {
+        while(n) {
+            unsigned long unit = (addr - BASE) / UNIT;
+            unsigned int order = 0;
+            while((order + 1 < ORDERS) && !(unit & ((1UL << (order + 1)) - 1)) && ((1UL << (order + 1)) <= n))
+                order++;
+
+            merge(addr, order);
+            _units += 1UL << order;
+            addr += UNIT << order;
+            n -= 1UL << order;
+        }
+    }
+
+    // Takes [addr, addr + n units) out of the free lists if all of it is free, giving back the rest of the blocks involved
+    bool claim(unsigned long addr, unsigned long n) {
+        if(!n || (addr < BASE) || ((addr - BASE) / UNIT + n > UNITS))
+            return false;
+
+        unsigned long end = addr + n * UNIT;
+        for(unsigned long a = addr; a < end; ) {
+            Block * b = containing(a);
+            if(!b)
+                return false;
+            a = b->addr + (UNIT << b->order);
+        }
+
+        for(unsigned long a = addr; a < end; ) {
+            Block * b = containing(a);
+            unsigned long start = b->addr;
+            unsigned int order = b->order;
+            unsigned long stop = start + (UNIT << order);
+            unlink(b, order);
+            _units -= 1UL << order;
+            if(start < addr)
+                free(start, (addr - start) / UNIT);
+            if(stop > end)
+                free(end, (stop - end) / UNIT);
+            a = stop;
+        }
+
+        return true;
+    }
+
+    // Number of free units
+    unsigned long available() const { return _units; }
+
+    // Size (in units) of the largest block that can be allocated right away
+    unsigned long largest() const {
+        for(int i = ORDERS - 1; i >= 0; i--)
+            if(_list[i])
+                return 1UL << i;
+        return 0;
+    }
+
+    // Number of free blocks of a given order
+    unsigned long blocks(unsigned int order) const { return (order < ORDERS) ? _blocks[order] : 0; }
+
+    // External fragmentation in percent: how much of the free memory cannot be
+    // handed out in a single piece (0 means all free units form one block)
+    unsigned int fragmentation() const { return _units ? 100 - (largest() * 100) / _units : 0; }
+
+    friend OStream & operator<<(OStream & os, const Buddy_Allocator & b) {
+        os << "{free=" << b._units << ",largest=" << b.largest() << ",frag=" << b.fragmentation() << "%,blocks=[";
+        for(unsigned int i = 0; i < ORDERS; i++)
+            os << b._blocks[i] << ((i + 1 < ORDERS) ? "," : "");
+        os << "]}";
+        return os;
+    }
+
+private:
+    void merge(unsigned long addr, unsigned int order) {
+        while(order + 1 < ORDERS) {
+            unsigned long buddy = BASE + (((addr - BASE) / UNIT) ^ (1UL << order)) * UNIT;
+            unsigned long index = (buddy - BASE) / UNIT;
+            if((index + (1UL << order) > UNITS) || !_head.test(index) || (block(buddy)->order != order))
+                break;
+            unlink(block(buddy), order);
+            if(buddy < addr)
+                addr = buddy;
+            order++;
+        }
+        link(addr, order);
+    }
+
+    // The free block holding addr, if any. The first block head found going up the orders is the only candidate.
+    Block * containing(unsigned long addr) const {
+        unsigned long unit = (addr - BASE) / UNIT;
+        for(unsigned int o = 0; o < ORDERS; o++) {
+            unsigned long head = unit & ~((1UL << o) - 1);
+            if(_head.test(head)) {
+                Block * b = block(BASE + head * UNIT);
+                return (head + (1UL << b->order) > unit) ? b : 0;
+            }
+        }
+        return 0;
+    }
+
+    static Block * block(unsigned long addr) { return reinterpret_cast<Block *>(Translation::log(addr)); }
+
+    void link(unsigned long addr, unsigned int order) {
+        Block * b = block(addr);
+        b->addr = addr;
+        b->order = order;
+        b->prev = 0;
+        b->next = _list[order];
+        if(b->next)
+            b->next->prev = b;
+        _list[order] = b;
+        _blocks[order]++;
+        _head.set((addr - BASE) / UNIT);
+    }
+
+    void unlink(Block * b, unsigned int order) {
+        if(b->prev)
+            b->prev->next = b->next;
+        else
+            _list[order] = b->next;
+        if(b->next)
+            b->next->prev = b->prev;
+        _blocks[order]--;
+        _head.reset((b->addr - BASE) / UNIT);
+    }
+
+private:
+    Block * _list[ORDERS];
+    unsigned long _blocks[ORDERS];
+    unsigned long _units;
+    Bitmap<UNITS> _head;
+};
+
+__END_UTIL
+
+#endif
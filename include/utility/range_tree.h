@@ -0,0 +1,144 @@
+// EPOS Range Tree Utility Declarations
+
+// Range_Tree tracks which of UNITS consecutive units are free and finds the
+// lowest run of n free units in O(log UNITS). It is a segment tree in which
+// every node stores the longest free run in its range plus the free runs
+// that touch either end of the range. Marking a run as free or used tags
+// whole subtrees and pushes the tags down lazily, so reserve() and release()
+// also cost O(log UNITS) no matter how long the run is. Tagged subtrees are
+// always uniformly free or used, so the const queries never need to push tags.
+// Leaves past UNITS (the tree is rounded up to a power of two) are permanently used.
+
+#ifndef __range_tree_h
+#define __range_tree_h
+
+#include <system/config.h>
+
+__BEGIN_UTIL
+
+template<unsigned long UNITS>
+class Range_Tree
+{
+private:
+    static constexpr unsigned long leaves(unsigned long n, unsigned long p = 1) { return (p >= n) ? p : leaves(n, p << 1); }
+
+public:
+    static const unsigned long LEAVES = leaves(UNITS);
+    static const unsigned long NONE = ~0UL;
+
+private:
+    enum : unsigned char { KEEP, FREE, USED };
+
+    struct Node {
+        unsigned int best;      // longest free run in the range
+        unsigned int prefix;    // free units at the beginning of the range
+        unsigned int suffix;    // free units at the end of the range
+        unsigned char pending;  // FREE or USED still to be pushed to the children
+    };
+
+public:
+    Range_Tree() { build(1, 0, LEAVES); }
+
+    // First unit of the lowest run of n free units, or NONE
+    unsigned long search(unsigned long n) const {
+        if(!n || (n > _node[1].best))
+            return NONE;
+        return search(1, 0, LEAVES, n);
+    }
+
+    // Whether all units in [start, start + n) are free
+    bool free(unsigned long start, unsigned long n) const {
+        if(!n || (start >= UNITS) || (n > UNITS - start))
+            return false;
+        return free(1, 0, LEAVES, start, start + n);
+    }
+
+    void reserve(unsigned long start, unsigned long n) { update(1, 0, LEAVES, start, start + n, USED); }
+    void release(unsigned long start, unsigned long n) { update(1, 0, LEAVES, start, start + n, FREE); }
+
+    // Finds and reserves the lowest run of n free units, returning its first unit or NONE
+    unsigned long alloc(unsigned long n) {
+        unsigned long start = search(n);
+        if(start != NONE)
+            reserve(start, n);
+        return start;
+    }
+
+    // Length of the longest free run
+    unsigned long largest() const { return _node[1].best; }
+
+private:
+    unsigned long search(unsigned long i, unsigned long l, unsigned long r, unsigned long n) const {
+        if(_node[i].best == r - l)
+            return l;
+        unsigned long m = (l + r) / 2;
+        if(_node[2 * i].best >= n)
+            return search(2 * i, l, m, n);
+        if(_node[2 * i].suffix + _node[2 * i + 1].prefix >= n)
+            return m - _node[2 * i].suffix;
+        return search(2 * i + 1, m, r, n);
+    }
+
+    bool free(unsigned long i, unsigned long l, unsigned long r, unsigned long a, unsigned long b) const {
+        if((b <= l) || (r <= a) || (_node[i].best == r - l))
+            return true;
+        if(!_node[i].best || ((a <= l) && (r <= b)))
+            return false;
+        unsigned long m = (l + r) / 2;
+        return free(2 * i, l, m, a, b) && free(2 * i + 1, m, r, a, b);
+    }
+
+    void update(unsigned long i, unsigned long l, unsigned long r, unsigned long a, unsigned long b, unsigned char v) {
+        if((b <= l) || (r <= a))
+            return;
+        if((a <= l) && (r <= b)) {
+            apply(i, r - l, v);
+            return;
+        }
+        unsigned long m = (l + r) / 2;
+        if(_node[i].pending != KEEP) {
+            apply(2 * i, m - l, _node[i].pending);
+            apply(2 * i + 1, r - m, _node[i].pending);
+            _node[i].pending = KEEP;
+        }
+        update(2 * i, l, m, a, b, v);
+        update(2 * i + 1, m, r, a, b, v);
+        pull(i, m - l);
+    }
+
+    void build(unsigned long i, unsigned long l, unsigned long r) {
+        if(r - l == 1) {
+            apply(i, 1, (l < UNITS) ? FREE : USED);
+            return;
+        }
+        unsigned long m = (l + r) / 2;
+        build(2 * i, l, m);
+        build(2 * i + 1, m, r);
+        _node[i].pending = KEEP;
+        pull(i, m - l);
+    }
+
+    void apply(unsigned long i, unsigned long len, unsigned char v) {
+        _node[i].best = _node[i].prefix = _node[i].suffix = (v == FREE) ? len : 0;
+        _node[i].pending = v;
+    }
+
+    void pull(unsigned long i, unsigned long half) {
+        const Node & left = _node[2 * i];
+        const Node & right = _node[2 * i + 1];
+        _node[i].prefix = (left.prefix == half) ? half + right.prefix : left.prefix;
+        _node[i].suffix = (right.suffix == half) ? half + left.suffix : right.suffix;
+        _node[i].best = left.suffix + right.prefix;
+        if(left.best > _node[i].best)
+            _node[i].best = left.best;
+        if(right.best > _node[i].best)
+            _node[i].best = right.best;
+    }
+
+private:
+    Node _node[2 * LEAVES];
+};
+
+__END_UTIL
+
+#endif
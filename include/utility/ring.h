@@ -0,0 +1,161 @@
+// EPOS Lock-free Ring Utility Declarations
+
+// SPSC_Ring is a bounded FIFO for exactly one producer and one consumer.
+// Each side owns one index and only reads the other's, so no atomic
+// read-modify-write is needed; fences order the slot accesses against the
+// index updates.
+
+// MPMC_Ring is a bounded FIFO for any number of producers and consumers.
+// Every slot carries a sequence number that tells whether it is free for the
+// producer at position "pos" (seq == pos) or holds data for the consumer at
+// that position (seq == pos + 1). Producers and consumers claim positions with
+// CPU::cas on the shared tail and head, so an operation fails only when the
+// ring is actually full or empty.
+
+// Neither ring ever blocks: insert() returns false when full and remove()
+// returns false when empty. See Blocking_Ring (synchronizer.h) for a wrapper
+// that sleeps on those conditions. Indices are unsigned longs, which wrap
+// around on 32-bit machines, so SIZE must be a power of two for "index % SIZE"
+// to stay continuous across the wrap; distances between indices are computed
+// by unsigned subtraction, which is wrap-safe.
+
+#ifndef __ring_h
+#define __ring_h
+
+#include <architecture.h>
+
+__BEGIN_UTIL
+
+template<typename T, unsigned long SIZE>
+class SPSC_Ring
+{
+public:
+    typedef T Object_Type;
+
+    static const unsigned long CAPACITY = SIZE;
+
+    static_assert(SIZE && !(SIZE & (SIZE - 1)), "ring SIZE must be a power of two");
+
+public:
+    SPSC_Ring(): _head(0), _tail(0) {}
+
+    bool empty() const { return _head == _tail; }
+    bool full() const { return (_tail - _head) == SIZE; }
+    unsigned long size() const { return _tail - _head; }
+
+    bool insert(const T & o) {
+        unsigned long tail = _tail;
+        if((tail - _head) == SIZE)
+            return false;
+
+        _ring[tail % SIZE] = o;
+        CPU::fence(); // publish the slot before the index
+        _tail = tail + 1;
+
+        return true;
+    }
+
+    bool remove(T * o) {
+        unsigned long head = _head;
+        if(head == _tail)
+            return false;
+
+        CPU::fence(); // see the slot written before _tail was advanced
+        *o = _ring[head % SIZE];
+        CPU::fence(); // finish reading before handing the slot back
+        _head = head + 1;
+
+        return true;
+    }
+
+private:
+    volatile unsigned long _head;
+    volatile unsigned long _tail;
+    T _ring[SIZE];
+};
+
+template<typename T, unsigned long SIZE>
+class MPMC_Ring
+{
+private:
+    struct Cell {
+        volatile unsigned long sequence;
+        T object;
+    };
+
+public:
+    typedef T Object_Type;
+
+    static const unsigned long CAPACITY = SIZE;
+
+    static_assert(SIZE && !(SIZE & (SIZE - 1)), "ring SIZE must be a power of two");
+
+public:
+    MPMC_Ring(): _head(0), _tail(0) {
+        for(unsigned long i = 0; i < SIZE; i++)
+            _ring[i].sequence = i;
+    }
+
+    bool empty() const { return static_cast<long>(_tail - _head) <= 0; }
+    bool full() const { return static_cast<long>(_tail - _head) >= static_cast<long>(SIZE); }
+    unsigned long size() const { long n = _tail - _head; return (n > 0) ? n : 0; }
+
+    bool insert(const T & o) {
+        Cell * cell;
+        unsigned long pos = _tail;
+        for(;;) {
+            cell = &_ring[pos % SIZE];
+            long diff = static_cast<long>(cell->sequence - pos);
+            if(diff == 0) {
+                unsigned long old = CPU::cas(_tail, pos, pos + 1);
+                if(old == pos)
+                    break;
+                pos = old;
+            } else if(diff < 0)
+                return false; // full: the slot still holds an unconsumed object
+            else
+                pos = _tail; // another producer took this position
+        }
+
+        CPU::fence();
+        cell->object = o;
+        CPU::fence();
+        cell->sequence = pos + 1;
+
+        return true;
+    }
+
+    bool remove(T * o) {
+        Cell * cell;
+        unsigned long pos = _head;
+        for(;;) {
+            cell = &_ring[pos % SIZE];
+            long diff = static_cast<long>(cell->sequence - (pos + 1));
+            if(diff == 0) {
+                unsigned long old = CPU::cas(_head, pos, pos + 1);
+                if(old == pos)
+                    break;
+                pos = old;
+            } else if(diff < 0)
+                return false; // empty: the producer has not published this slot yet
+            else
+                pos = _head;
+        }
+
+        CPU::fence();
+        *o = cell->object;
+        CPU::fence();
+        cell->sequence = pos + SIZE;
+
+        return true;
+    }
+
+private:
+    volatile unsigned long _head;
+    volatile unsigned long _tail;
+    Cell _ring[SIZE];
+};
+
+__END_UTIL
+
+#endif
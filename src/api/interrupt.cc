@@ -0,0 +1,99 @@
+// EPOS Threaded Interrupt Handler Implementation
+
+#include <interrupt.h>
+
+__BEGIN_SYS
+
+// Class attributes
+Interrupt_Thread *Interrupt_Thread::_threads[IC::INTS];
+
+volatile bool Interrupt_Balancer::_locked;
+unsigned int Interrupt_Balancer::_hard_rt[CPUS];
+unsigned int Interrupt_Balancer::_load[CPUS];
+unsigned char Interrupt_Balancer::_cpu[IC::INTS];
+
+// Methods
+void Interrupt_Balancer::steer(Interrupt_Id id)
+{
+    bool e = lock();
+
+    if (_cpu[id])
+        _load[_cpu[id] - 1]--;
+    route(id, best());
+
+    unlock(e);
+}
+
+void Interrupt_Balancer::forget(Interrupt_Id id)
+{
+    bool e = lock();
+
+    if (_cpu[id])
+        _load[_cpu[id] - 1]--;
+    _cpu[id] = 0;
+
+    unlock(e);
+}
+
+void Interrupt_Balancer::partition(unsigned int cpu, bool join)
+{
+    db<IC>(TRC) << "Interrupt_Balancer::partition(cpu=" << cpu << ",join=" << join << ")" << endl;
+
+    bool e = lock();
+
+    if (join)
+    {
+        if (_hard_rt[cpu]++ == 0)
+        {
+            // The hart just became hard real-time: move its sources elsewhere
+            for (Interrupt_Id id = 0; id < IC::INTS; id++)
+                if (_cpu[id] == cpu + 1)
+                {
+                    _load[cpu]--;
+                    route(id, best());
+                }
+        }
+    }
+    else if (_hard_rt[cpu] && (--_hard_rt[cpu] == 0))
+    {
+        // The hart is no longer hard real-time: take sources back from hard real-time harts first,
+        // then from harts with at least two more sources than the best one, so the load evens out
+        for (unsigned int pass = 0; pass < 2; pass++)
+            for (Interrupt_Id id = 0; id < IC::INTS; id++)
+                if (_cpu[id] && (bool(_hard_rt[_cpu[id] - 1]) == (pass == 0)))
+                {
+                    unsigned int from = _cpu[id] - 1;
+                    _load[from]--;
+                    unsigned int to = best();
+                    if ((to != from) && ((_hard_rt[from] && !_hard_rt[to]) || (_load[to] < _load[from])))
+                        route(id, to);
+                    else
+                        _load[from]++;
+                }
+    }
+
+    unlock(e);
+}
+
+unsigned int Interrupt_Balancer::best()
+{
+    unsigned int best = 0;
+    for (unsigned int cpu = 1; cpu < CPU::cores(); cpu++)
+    {
+        bool hard = _hard_rt[cpu], best_hard = _hard_rt[best];
+        if ((hard < best_hard) || ((hard == best_hard) && (_load[cpu] < _load[best])))
+            best = cpu;
+    }
+    return best;
+}
+
+void Interrupt_Balancer::route(Interrupt_Id id, unsigned int cpu)
+{
+    db<IC>(INF) << "Interrupt_Balancer::route(int=" << id << ",cpu=" << cpu << ")" << endl;
+
+    _cpu[id] = cpu + 1;
+    _load[cpu]++;
+    IC::affinity(id, 1UL << cpu);
+}
+
+__END_SYS
@@ -4,7 +4,7 @@
 
 __BEGIN_SYS
 
-Mutex::Mutex() : _locked(false)
+Mutex::Mutex() : _locked(false), _owner(0)
 {
     db<Synchronizer>(TRC) << "Mutex() => " << this << endl;
 }
@@ -17,6 +17,10 @@ Mutex::~Mutex()
 void Mutex::lock()
 {
     db<Synchronizer>(TRC) << "Mutex::lock(this=" << this << ")" << endl;
+
+    if (adaptive)
+        spin();
+
     _lock();
     if (Traits<Synchronizer>::CEILING_PROTOCOL)
     {
@@ -52,6 +56,7 @@ void Mutex::lock()
             sleep();
         }
     }
+    _owner = Thread::self();
     _unlock();
 }
 
@@ -60,6 +65,7 @@ void Mutex::unlock()
     db<Synchronizer>(TRC) << "Mutex::unlock(this=" << this << ")" << endl;
 
     _lock();
+    _owner = 0;
     if (Traits<Synchronizer>::CEILING_PROTOCOL)
     {
         Thread *exec_thread = Thread::self();
@@ -84,4 +90,22 @@ void Mutex::unlock()
     _unlock();
 }
 
+// Busy-waits outside the thread lock while the owner is running on another core.
+// A holder that is running is likely to release the mutex before a sleep/wakeup
+// round trip (two context switches plus an IPI) would complete. Gives up after
+// SPIN_LIMIT microseconds, measured with the TSC so the bound does not depend on
+// the clock or on how fast the loop runs, or as soon as the owner is preempted or
+// blocked, and lets lock() take the regular path, which still decides the outcome
+// under the lock.
+void Mutex::spin()
+{
+    TSC::Time_Stamp deadline = TSC::time_stamp() + TSC::Time_Stamp(SPIN_LIMIT) * TSC::frequency() / 1000000;
+    while (_locked && (TSC::time_stamp() < deadline))
+    {
+        Thread *owner = _owner;
+        if (!owner || (owner == Thread::self()) || !Thread::_cpu_lookup_table.running(owner))
+            break;
+    }
+}
+
 __END_SYS
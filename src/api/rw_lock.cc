@@ -0,0 +1,143 @@
+// EPOS Readers-Writer Lock Implementation
+
+#include <synchronizer.h>
+
+__BEGIN_SYS
+
+RW_Lock::RW_Lock() : _readers(0), _writing(false), _waiting_readers(0)
+{
+    db<Synchronizer>(TRC) << "RW_Lock() => " << this << endl;
+}
+
+RW_Lock::~RW_Lock()
+{
+    db<Synchronizer>(TRC) << "~RW_Lock(this=" << this << ")" << endl;
+
+    _lock();
+    if (!_readers_waiting.empty())
+    {
+        db<Synchronizer>(WRN) << "~RW_Lock(this=" << this << ") called with blocked readers!" << endl;
+        wakeup_all(&_readers_waiting);
+    }
+    _unlock();
+}
+
+void RW_Lock::read_lock()
+{
+    db<Synchronizer>(TRC) << "RW_Lock::read_lock(this=" << this << ",readers=" << _readers << ")" << endl;
+
+    _lock();
+    // Pending writers are preferred over new readers
+    if (_writing || !_waiting.empty())
+    {
+        _waiting_readers++;
+        wait(&_readers_waiting);
+        // write_unlock() accounted for us in _readers before waking us up
+    }
+    else
+        _readers++;
+    acquired();
+    _unlock();
+}
+
+void RW_Lock::read_unlock()
+{
+    db<Synchronizer>(TRC) << "RW_Lock::read_unlock(this=" << this << ",readers=" << _readers << ")" << endl;
+
+    _lock();
+    if ((--_readers == 0) && !_waiting.empty())
+    {
+        // Hand the lock over to the most urgent writer
+        _writing = true;
+        wakeup();
+    }
+    released();
+    _unlock();
+}
+
+void RW_Lock::write_lock()
+{
+    db<Synchronizer>(TRC) << "RW_Lock::write_lock(this=" << this << ",readers=" << _readers << ")" << endl;
+
+    _lock();
+    if (_writing || (_readers > 0))
+    {
+        wait(&_waiting);
+        // The releasing thread set _writing on our behalf
+    }
+    else
+        _writing = true;
+    acquired();
+    _unlock();
+}
+
+void RW_Lock::write_unlock()
+{
+    db<Synchronizer>(TRC) << "RW_Lock::write_unlock(this=" << this << ")" << endl;
+
+    _lock();
+    if (!_waiting.empty())
+        wakeup(); // writer preference: keep _writing and pass the lock on
+    else
+    {
+        _writing = false;
+        if (_waiting_readers)
+        {
+            _readers += _waiting_readers;
+            _waiting_readers = 0;
+            wakeup_all(&_readers_waiting);
+        }
+    }
+    released();
+    _unlock();
+}
+
+// Blocks the running thread on q, applying the ceiling/inheritance protocol while it waits
+void RW_Lock::wait(Sync_Queue *q)
+{
+    if (Traits<Synchronizer>::CEILING_PROTOCOL)
+    {
+        Thread *exec_thread = Thread::self();
+
+        waitingThreadsCount++;
+        insertSyncObject(exec_thread, &resource_waiting_list);
+        activateCeiling(getMostUrgentPriority());
+
+        sleep(q);
+
+        waitingThreadsCount--;
+        removeSyncObject(exec_thread, &resource_waiting_list);
+        recalculatePriorities();
+    }
+    else
+        sleep(q);
+}
+
+// Registers the running thread as a holder (one of many readers or the writer)
+void RW_Lock::acquired()
+{
+    if (Traits<Synchronizer>::CEILING_PROTOCOL)
+    {
+        Thread *exec_thread = Thread::self();
+
+        exec_thread->enter_zone();
+        exec_thread->addSynchronizer(this);
+        insertSyncObject(exec_thread, &resource_holder_list);
+        checkForThreadProtocol(exec_thread);
+    }
+}
+
+void RW_Lock::released()
+{
+    if (Traits<Synchronizer>::CEILING_PROTOCOL)
+    {
+        Thread *exec_thread = Thread::self();
+
+        exec_thread->leave_zone();
+        exec_thread->removeSynchronizer(this);
+        removeSyncObject(exec_thread, &resource_holder_list);
+        shiftProtocol(exec_thread);
+    }
+}
+
+__END_SYS
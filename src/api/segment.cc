@@ -13,6 +13,13 @@ Segment::Segment(unsigned long bytes, Flags flags)
                    << "] => " << this << endl;
 }
 
+Segment::Segment(unsigned long bytes, Flags flags, const Color_Set & colors)
+    : Chunk(bytes, flags, colors) {
+  db<Segment>(TRC) << "Segment(bytes=" << bytes << ",flags=" << flags
+                   << ",colors=" << colors << ") [Chunk::pt=" << Chunk::pt()
+                   << ",sz=" << Chunk::size() << "] => " << this << endl;
+}
+
 Segment::Segment(Phy_Addr phy_addr, unsigned long bytes, Flags flags)
     : Chunk(phy_addr, bytes, flags | Flags::IO)
 // The MMU::IO flag signalizes the MMU that the attached memory shall not be
@@ -23,6 +30,16 @@ Segment::Segment(Phy_Addr phy_addr, unsigned long bytes, Flags flags)
                    << ",sz=" << Chunk::size() << "] => " << this << endl;
 }
 
+// Frames are shared read-only with "seg" and copied on the first write to each page
+// if copy_on_write is set (and the MMU supports it), or copied right away otherwise
+Segment::Segment(const Segment & seg, bool copy_on_write)
+    : Chunk(seg, copy_on_write)
+{
+  db<Segment>(TRC) << "Segment(seg=" << &seg << ",cow=" << copy_on_write
+                   << ") [Chunk::pt=" << Chunk::pt() << ",sz=" << Chunk::size()
+                   << "] => " << this << endl;
+}
+
 Segment::~Segment()
 {
     db<Segment>(TRC) << "~Segment() [Chunk::pt=" << Chunk::pt() << "]" << endl;
@@ -3,6 +3,7 @@
 #include <machine.h>
 #include <system.h>
 #include <process.h>
+#include <memory.h>
 
 extern "C"
 {
@@ -25,14 +26,27 @@ Thread *volatile Thread::self()
 	return _not_booting ? running() : reinterpret_cast<Thread *volatile>(CPU::id() + 1);
 }
 
-void Thread::constructor_prologue(unsigned int stack_size)
+void Thread::constructor_prologue(unsigned int stack_size, const Color_Set &colors)
 {
     lock();
 
     _thread_count++;
     _scheduler.insert(this);
 
-    _stack = new (SYSTEM) char[stack_size];
+    _colors = colors;
+    if (colors.empty()) // no color asked for (an explicit COLOR_0 still gets a colored stack)
+    {
+        _stack_segment = 0;
+        _stack_pd = 0;
+        _stack = new (SYSTEM) char[stack_size];
+    }
+    else
+    {
+        // The heap is not colored, so the stack gets its own segment, detached later from the same address space
+        _stack_segment = new (SYSTEM) Segment(stack_size, Segment::Flags::SYSD, colors);
+        _stack_pd = MMU::current();
+        _stack = Address_Space(_stack_pd).attach(_stack_segment);
+    }
 }
 
 void Thread::constructor_epilogue(Log_Addr entry, unsigned int stack_size)
@@ -141,7 +155,13 @@ Thread::~Thread()
 
     unlock();
 
-    delete _stack;
+    if (_stack_segment)
+    {
+        Address_Space(_stack_pd).detach(_stack_segment, _stack); // the thread may be deleted from another address space
+        delete _stack_segment;
+    }
+    else
+        delete _stack;
 }
 
 int Thread::join()
@@ -628,12 +648,16 @@ int Thread::idle()
 	// By convention of our own, nullptr = idle in the lookup table.
 	_cpu_lookup_table.clear_cpu(CPU::id());
 
+	// Printed only once: with buffered UART output, each print raises a TX interrupt that wakes
+	// the halted hart up again, so printing on every pass would keep it from ever sleeping.
+    db<Thread>(WRN) << "Halting the machine ..." << endl;
+
 	// someone else besides idle
     while (_thread_count > CPU::cores())
     { 
-        db<Thread>(WRN) << "Halting the machine ..." << endl;
 		_cpu_lookup_table.clear_cpu(CPU::id());
         CPU::int_enable();
+        MMU::prezero(); // zero frames for MMU::calloc() while there is nothing else to do
         CPU::halt();
 
         // a thread might have been woken up by another CPU
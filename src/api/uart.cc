@@ -0,0 +1,134 @@
+// EPOS RISC-V UART Buffered Input Implementation
+
+// Everything in the UART mediator that blocks or wakes up threads. SETUP links
+// the machine library, but not the system library, so this cannot live with
+// the rest of the mediator in src/machine/riscv/riscv_uart.cc.
+
+#include <machine/uart.h>
+
+#ifdef __riscv__
+
+#include <machine/ic.h>
+#include <synchronizer.h>
+
+__BEGIN_SYS
+
+// Class attributes
+Semaphore UART::_rx_ready(0);
+
+// Methods
+void UART::buffered(bool enable)
+{
+    db<UART>(TRC) << "UART::buffered(e=" << enable << ")" << endl;
+
+    if((!TX_BUFFER_SIZE && !RX_BUFFER_SIZE) || (enable == _buffered))
+        return;
+
+    if(enable) {
+        _owner = this;
+        IC::int_vector(IC::INT_UART0, &int_handler);
+        IC::enable(IC::INT_UART0);
+        _buffered = true;
+        if(RX_BUFFER_SIZE)
+            int_enable(true, false, false, false);
+    } else {
+        int_disable(true, false, false, false);
+        _buffered = false;
+        flush();
+        int_disable(false, true, false, false);
+    }
+}
+
+int UART::readline(char * line, unsigned int max, bool echo)
+{
+    unsigned int i = 0;
+
+    while(true) {
+        char c = get();
+
+        if((c == '\r') || (c == '\n')) {
+            if(echo) {
+                put('\r');
+                put('\n');
+            }
+            break;
+        }
+
+        if((c == '\b') || (c == 0x7f)) { // backspace or delete
+            if(i) {
+                i--;
+                if(echo) {
+                    put('\b');
+                    put(' ');
+                    put('\b');
+                }
+            }
+            continue;
+        }
+
+        if(i + 1 < max) {
+            line[i++] = c;
+            if(echo)
+                put(c);
+        }
+    }
+
+    if(max)
+        line[i] = '\0';
+
+    return i;
+}
+
+char UART::dequeue()
+{
+    _rx_ready.p();
+
+    bool e = lock();
+    char c = _rx[_rx_head];
+    _rx_head = (_rx_head + 1) % RX_BUFFER_SIZE;
+    unlock(e);
+
+    return c;
+}
+
+void UART::int_handler(IC::Interrupt_Id i)
+{
+    unsigned int received = 0;
+
+    bool e = lock();
+
+    if(RX_BUFFER_SIZE) {
+        while(_owner->rxd_ok()) {
+            char c = _owner->rxd();
+            unsigned int next = (_rx_tail + 1) % RX_BUFFER_SIZE;
+            if(next == _rx_head)
+                _rx_overruns++;
+            else {
+                _rx[_rx_tail] = c;
+                _rx_tail = next;
+                received++;
+            }
+        }
+    }
+
+    if(TX_BUFFER_SIZE) {
+        while((_tx_head != _tx_tail) && _owner->txd_ok()) {
+            _owner->txd(_tx[_tx_head]);
+            _tx_head = (_tx_head + 1) % TX_BUFFER_SIZE;
+        }
+
+        // The TX watermark stays up while the FIFO is low, so it must be masked once there is nothing left to send
+        if(_tx_head == _tx_tail)
+            _owner->int_disable(false, true, false, false);
+    }
+
+    unlock(e);
+
+    // Readers are woken up only after the lock is released, since v() may reschedule
+    while(received--)
+        _rx_ready.v();
+}
+
+__END_SYS
+
+#endif
@@ -74,5 +74,35 @@ void CPU::switch_context(Context ** o, Context * n)     // "o" is in a0 and "n"
     iret();
 }
 
+// Supervisor mode can only program its own timer if the hart has Sstc and machine mode enabled it through menvcfg.STCE.
+// Otherwise stimecmp accesses are illegal instructions, which skip() steps over while probing.
+bool CPU::sstc()
+{
+    if(!supervisor)
+        return false;
+
+    bool enabled = int_enabled();
+    int_disable();
+    Reg tvec = stvec();
+    stvec(INT_DIRECT, &skip);
+
+    stimecmp(-1ULL); // never fires
+    bool present = (stimecmp() == -1ULL);
+
+    stvec(tvec & 3, tvec & -4UL);
+    if(enabled)
+        int_enable();
+
+    return present;
+}
+
+void CPU::skip()
+{
+    ASM("       csrr     x3,    sepc            \n"
+        "       addi     x3, x3, 4              \n"   // CSR instructions are never compressed
+        "       csrw     sepc, x3               \n"
+        "       sret                            \n");
+}
+
 __END_SYS
 
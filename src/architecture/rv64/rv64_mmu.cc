@@ -0,0 +1,285 @@
+// EPOS RISC-V 64 MMU Mediator Implementation
+
+#include <architecture/rv64/rv64_mmu.h>
+#include <machine/ic.h>
+
+__BEGIN_SYS
+
+// Class attributes
+SV39_MMU::Buddy SV39_MMU::_free[colorful * COLORS + 1];
+volatile bool SV39_MMU::_free_lock;
+SV39_MMU::Page_Directory * SV39_MMU::_master;
+Bitmap<SV39_MMU::ASIDS> SV39_MMU::_asids;
+unsigned int SV39_MMU::_asid_count;
+volatile bool SV39_MMU::_asid_lock;
+volatile unsigned long SV39_MMU::_harts[ASIDS];
+volatile bool SV39_MMU::_shootdown_lock;
+SV39_MMU::Log_Addr SV39_MMU::_shootdown_addr;
+unsigned long SV39_MMU::_shootdown_pages;
+unsigned int SV39_MMU::_shootdown_asid;
+volatile unsigned long SV39_MMU::_shootdown_pending;
+volatile bool SV39_MMU::_fault_lock;
+unsigned short SV39_MMU::_shares[(RAM_TOP - RAM_BASE + 1) / sizeof(Frame)];
+SV39_MMU::Phy_Addr SV39_MMU::_zeroed[colorful * COLORS + 1][ZEROED_FRAMES + 1];
+unsigned int SV39_MMU::_zeroed_count[colorful * COLORS + 1];
+volatile bool SV39_MMU::_zeroed_lock;
+
+// Class methods
+unsigned int SV39_MMU::asid_alloc()
+{
+    unsigned int asid = 0;
+
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+    while(CPU::tsl(_asid_lock));
+    for(unsigned int i = 1; i < _asid_count; i++)
+        if(_asids.set(i)) {
+            asid = i;
+            break;
+        }
+    _asid_lock = false;
+    if(enabled)
+        CPU::int_enable();
+
+    if(!asid && (_asid_count > 1))
+        db<MMU>(WRN) << "MMU::asid_alloc: out of ASIDs, falling back to global flushes!" << endl;
+
+    db<MMU>(TRC) << "MMU::asid_alloc() => " << asid << endl;
+
+    return asid;
+}
+
+void SV39_MMU::asid_free(unsigned int asid)
+{
+    db<MMU>(TRC) << "MMU::asid_free(asid=" << asid << ")" << endl;
+
+    if(!asid)
+        return;
+
+    // Stale entries must be gone from every hart that ran it before the ASID can be handed out again
+    shootdown(0, 0, asid);
+    _harts[asid] = 0;
+
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+    while(CPU::tsl(_asid_lock));
+    _asids.reset(asid);
+    _asid_lock = false;
+    if(enabled)
+        CPU::int_enable();
+}
+
+SV39_MMU::Phy_Addr SV39_MMU::zeroed(Color color)
+{
+    if(!ZEROED_FRAMES || !_zeroed_count[color]) // racy peek, rechecked under the lock
+        return Phy_Addr(false);
+
+    Phy_Addr phy(false);
+
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+    while(CPU::tsl(_zeroed_lock));
+    if(_zeroed_count[color])
+        phy = _zeroed[color][--_zeroed_count[color]];
+    _zeroed_lock = false;
+    if(enabled)
+        CPU::int_enable();
+
+    return phy;
+}
+
+void SV39_MMU::prezero()
+{
+    if(!ZEROED_FRAMES)
+        return;
+
+    // One frame at a time, so the idle thread can be preempted anywhere. Frames are taken and given back through
+    // alloc() and free(), under _free_lock, since the idle threads of all harts refill concurrently with other
+    // allocations, and are zeroed outside of any lock.
+    for(unsigned int color = 0; color < colorful * COLORS + 1; color++)
+        while(_zeroed_count[color] < ZEROED_FRAMES) {
+            Phy_Addr phy = alloc(1, Color(color));
+            if(!phy)
+                break;
+            memset(phy2log(phy), 0, sizeof(Frame));
+
+            bool enabled = CPU::int_enabled();
+            CPU::int_disable();
+            while(CPU::tsl(_zeroed_lock));
+            bool kept = _zeroed_count[color] < ZEROED_FRAMES; // other idle threads may have filled it meanwhile
+            if(kept)
+                _zeroed[color][_zeroed_count[color]++] = phy;
+            _zeroed_lock = false;
+            if(enabled)
+                CPU::int_enable();
+
+            if(!kept)
+                free(phy);
+        }
+}
+
+void SV39_MMU::share(Phy_Addr frame)
+{
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+    while(CPU::tsl(_fault_lock));
+    _shares[(frame - RAM_BASE) / sizeof(Frame)]++;
+    _fault_lock = false;
+    if(enabled)
+        CPU::int_enable();
+}
+
+void SV39_MMU::release(Phy_Addr frame)
+{
+    bool shared;
+
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+    while(CPU::tsl(_fault_lock));
+    unsigned short & shares = _shares[(frame - RAM_BASE) / sizeof(Frame)];
+    shared = shares;
+    if(shared)
+        shares--;
+    _fault_lock = false;
+    if(enabled)
+        CPU::int_enable();
+
+    if(!shared)
+        free(frame);
+}
+
+bool SV39_MMU::fault(Log_Addr addr, bool write)
+{
+    PD_Entry pde = current()->log()[pdi(addr)];
+    if(!(pde & Page_Flags::V))
+        return false;
+    Attacher * at = pde2phy(pde);
+    PT_Entry ate = at->log()[ati(addr)];
+    if(!(ate & Page_Flags::V) || leaf(ate))
+        return false;
+    Page_Table * pt = ate2phy(ate);
+
+    bool retry = false;
+    bool copied = false;
+
+    // _fault_lock only keeps faults from racing on the same entry; the frames come from calloc() and alloc(),
+    // which take _free_lock (nested inside this one) against every other user of the allocator
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+    while(CPU::tsl(_fault_lock));
+
+    PT_Entry & pte = pt->log()[pti(addr)];
+    if(lazy(pte)) {
+        Phy_Addr frame = calloc(1, colorful ? phy2color(pt) : WHITE);
+        if(frame) {
+            pte = phy2pte(frame, Page_Flags(pte2flg(pte) | Page_Flags::V));
+            retry = true;
+        }
+    } else if(write && cow(pte)) {
+        // Writing to a shared page: the last sharer just takes it over, the others get a private copy
+        Phy_Addr frame = pte2phy(pte);
+        Page_Flags flags = (pte2flg(pte) & ~Page_Flags::CW) | Page_Flags::W;
+        unsigned short & shares = _shares[(frame - RAM_BASE) / sizeof(Frame)];
+        if(!shares) {
+            pte = phy2pte(frame, flags);
+            retry = true;
+        } else {
+            Phy_Addr copy = alloc(1, colorful ? phy2color(pt) : WHITE);
+            if(copy) {
+                memcpy(phy2log(copy), phy2log(frame), sizeof(Frame));
+                shares--;
+                pte = phy2pte(copy, flags);
+                retry = copied = true;
+            }
+        }
+    } else if(pte & Page_Flags::V)
+        retry = pte & (write ? Page_Flags::W : Page_Flags::R); // another hart got here first
+
+    _fault_lock = false;
+    if(enabled)
+        CPU::int_enable();
+
+    if(copied)
+        shootdown(addr - off(addr), 1, 0); // the chunk may be attached elsewhere with the old frame cached
+    else if(retry)
+        CPU::flush_tlb(addr);
+
+    db<MMU>(TRC) << "MMU::fault(addr=" << addr << ",write=" << write << ") => " << retry << endl;
+
+    return retry;
+}
+
+void SV39_MMU::flush_tlb(Log_Addr addr, unsigned long pages, unsigned int asid)
+{
+    if(!pages || (pages > SHOOTDOWN_PAGES)) {
+        if(asid)
+            CPU::flush_asid(asid);
+        else
+            CPU::flush_tlb();
+    } else
+        for(unsigned long i = 0; i < pages; i++, addr += sizeof(Page))
+            if(asid)
+                CPU::flush_tlb(addr, asid);
+            else
+                CPU::flush_tlb(addr);
+}
+
+void SV39_MMU::shootdown(Log_Addr addr, unsigned long pages, unsigned int asid)
+{
+    db<MMU>(TRC) << "MMU::shootdown(addr=" << addr << ",pages=" << pages << ",asid=" << asid << ")" << endl;
+
+    flush_tlb(addr, pages, asid);
+
+    if(!Traits<Machine>::multi || (CPU::cores() == 1))
+        return;
+
+    unsigned long self = 1UL << CPU::id();
+    unsigned long all = (CPU::cores() >= sizeof(unsigned long) * 8) ? ~0UL : (1UL << CPU::cores()) - 1;
+    CPU::fence(); // page table updates must be visible before the targets are chosen
+    unsigned long targets = (asid ? _harts[asid] : all) & all & ~self;
+    if(!targets)
+        return;
+
+    if(IC::int_vector(IC::INT_SHOOTDOWN) != &shootdown_handler)
+        IC::int_vector(IC::INT_SHOOTDOWN, &shootdown_handler);
+
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+
+    // Keep serving requests aimed at us while waiting for the mailbox, otherwise two initiators could wait on each other
+    while(CPU::tsl(_shootdown_lock))
+        if(_shootdown_pending & self)
+            shootdown_handler(IC::INT_SHOOTDOWN);
+
+    _shootdown_addr = addr;
+    _shootdown_pages = pages;
+    _shootdown_asid = asid;
+    CPU::fence();
+    _shootdown_pending = targets;
+
+    for(unsigned int cpu = 0; cpu < CPU::cores(); cpu++)
+        if(targets & (1UL << cpu))
+            IC::ipi(cpu, IC::INT_SHOOTDOWN);
+
+    while(_shootdown_pending);
+
+    _shootdown_lock = false;
+    if(enabled)
+        CPU::int_enable();
+}
+
+void SV39_MMU::shootdown_handler(CPU::Interrupt_Id i)
+{
+    unsigned long self = 1UL << CPU::id();
+    if(!(_shootdown_pending & self))
+        return;
+
+    flush_tlb(_shootdown_addr, _shootdown_pages, _shootdown_asid);
+
+    unsigned long pending;
+    do
+        pending = _shootdown_pending;
+    while(CPU::cas(_shootdown_pending, pending, pending & ~self) != pending);
+}
+
+__END_SYS
@@ -0,0 +1,56 @@
+// EPOS RISC-V 64 MMU Mediator Initialization
+
+#include <architecture/rv64/rv64_mmu.h>
+#include <system.h>
+
+__BEGIN_SYS
+
+void SV39_MMU::init()
+{
+    db<Init, MMU>(TRC) << "MMU::init()" << endl;
+
+    System_Info * si = System::info();
+
+    db<Init, MMU>(INF) << "MMU::memory={base=" << reinterpret_cast<void *>(si->bm.mem_base) << ",size="
+                       << (si->bm.mem_top - si->bm.mem_base) / 1024 << "KB}" << endl;
+    db<Init, MMU>(INF) << "MMU::free1={base=" << reinterpret_cast<void *>(si->pmm.free1_base) << ",size="
+                       << (si->pmm.free1_top - si->pmm.free1_base) / 1024 << "KB}" << endl;
+
+    // The buddy allocator keeps its links in the first bytes of each free block,
+    // so SETUP's leftovers can be handed over while still in use by INIT as long
+    // as INIT does not live in the first frames of the chunk
+    if(colorful) {
+        // Make sure the System's heap can be served from WHITE before coloring the rest
+        unsigned long base = si->pmm.free1_base;
+        unsigned long top = si->pmm.free1_top;
+        unsigned long heap = pages(Traits<System>::HEAP_SIZE) * sizeof(Page);
+        if((top - base) < heap)
+            db<Init, MMU>(ERR) << "MMU::init: System's heap size (Traits<System>::HEAP_SIZE=" << Traits<System>::HEAP_SIZE << ") is larger than memory!" << endl;
+        else {
+            white_free(base, pages(heap));
+            base += heap;
+        }
+
+        for(; base < top; base += sizeof(Page))
+            free(base);
+    } else
+        free(si->pmm.free1_base, pages(si->pmm.free1_top - si->pmm.free1_base));
+
+    db<Init, MMU>(INF) << "MMU::free[WHITE]=" << _free[WHITE] << endl;
+
+    // Probe how many ASIDs the hardware implements: the ASID field of satp is WARL,
+    // so writing all ones and reading it back yields the largest supported value
+    Reg satp = CPU::satp();
+    CPU::satp(satp | (ASID_MASK << ASID_SHIFT));
+    unsigned long asids = ((CPU::satp() >> ASID_SHIFT) & ASID_MASK) + 1;
+    CPU::satp(satp);
+    _asid_count = (asids < ASIDS) ? asids : ASIDS;
+    _asids.set(0); // shared by the master directory and whatever cannot get an ASID of its own
+    db<Init, MMU>(INF) << "MMU::asids=" << _asid_count << (_asid_count > 1 ? "" : " (TLBs will be flushed on every switch)") << endl;
+
+    // Remember the master page directory (created during SETUP)
+    _master = current();
+    db<Init, MMU>(INF) << "MMU::master page directory=" << _master << endl;
+}
+
+__END_SYS
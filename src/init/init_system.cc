@@ -26,7 +26,8 @@ public:
         {
             if (Traits<System>::multiheap)
             {
-                System::_heap_segment = new (&System::_preheap[0]) Segment(HEAP_SIZE, Segment::Flags::SYSD);
+                // Contiguous and fixed (the heap is never reflagged or resized), so the MMU can map it with megapages
+                System::_heap_segment = new (&System::_preheap[0]) Segment(HEAP_SIZE, Segment::Flags::SYSD | Segment::Flags::CT | Segment::Flags::FX);
                 char *heap;
                 if (Memory_Map::SYS_HEAP == Traits<Machine>::NOT_USED)
                     heap = Address_Space(MMU::current()).attach(System::_heap_segment);
@@ -13,8 +13,11 @@ extern "C"
 
 __BEGIN_SYS
 
-PLIC::Reg32 PLIC::_claimed;
+PLIC::Reg32 PLIC::_claimed[Traits<Build>::CPUS];
 IC::Interrupt_Handler IC::_int_vector[IC::INTS];
+volatile IC::Reg IC::_ipis[Traits<Build>::CPUS];
+unsigned char IC::_priority[PLIC::IRQS];
+unsigned long IC::_affinity[PLIC::IRQS];
 
 void IC::entry()
 {
@@ -34,41 +37,64 @@ void IC::entry()
     CPU::iret();
 }
 
+// Lean entries: the timer and software interrupts never need claim() nor the full context, since their
+// handlers are plain functions and switch_context() saves the rest if they reschedule
+void IC::timer_entry()
+{
+    CPU::Context::push_lean();
+    timer_dispatch();
+    CPU::Context::pop_lean();
+    CPU::iret();
+}
+
+void IC::soft_entry()
+{
+    CPU::Context::push_lean();
+    soft_dispatch();
+    CPU::Context::pop_lean();
+    CPU::iret();
+}
+
+void IC::vector()
+{
+    // One 4-byte jump per interrupt code in [m|s]cause (compressed jumps would break the stride)
+    ASM(".option push                           \n"
+        ".option norvc                          \n"
+        "       j       %0                      \n"
+        "       j       %1                      \n"
+        "       j       %2                      \n"
+        "       j       %3                      \n"
+        "       j       %4                      \n"
+        "       j       %5                      \n"
+        "       j       %6                      \n"
+        "       j       %7                      \n"
+        "       j       %8                      \n"
+        "       j       %9                      \n"
+        "       j       %10                     \n"
+        "       j       %11                     \n"
+        "       j       %12                     \n"
+        "       j       %13                     \n"
+        "       j       %14                     \n"
+        "       j       %15                     \n"
+        ".option pop                            \n"
+        : : "i"(vector_entry(0)), "i"(vector_entry(1)), "i"(vector_entry(2)), "i"(vector_entry(3)),
+            "i"(vector_entry(4)), "i"(vector_entry(5)), "i"(vector_entry(6)), "i"(vector_entry(7)),
+            "i"(vector_entry(8)), "i"(vector_entry(9)), "i"(vector_entry(10)), "i"(vector_entry(11)),
+            "i"(vector_entry(12)), "i"(vector_entry(13)), "i"(vector_entry(14)), "i"(vector_entry(15)));
+}
+
 void IC::dispatch()
 {
     Interrupt_Id id = int_id();
 
-    if (supervisor)
-    {
-        if (id == INT_RESCHEDULER)
-		{
-			// IPI EOI was already issued by _int_m2s, 
-			// so we only clear SSI
-            CPU::sipc(CPU::SSI); 
-		}
-        else if (id == INT_SYS_TIMER)
-		{
-			// we can't clear CPU::sipc(CPU::STI) in supervisor mode, 
-			// so let's ecall int_m2s to do it for us
-            CPU::ecall(); 
-		}
-    }
+    if (id == INT_RESCHEDULER)
+        soft_dispatch();
+    else if (id == INT_SYS_TIMER)
+        timer_dispatch();
+    else if ((id > HARD_INT) && (id < SOFT_INT))
+        plic_dispatch(id);
     else
-    {
-        if (id == INT_RESCHEDULER)
-		{
-			db<Thread>(WRN) << "ic receive " << id << endl;
-            IC::ipi_eoi(id & CLINT::INT_MASK);
-		}
-        else if (id == INT_SYS_TIMER)
-		{
-			// MIP.MTI is a direct logic on (MTIME == MTIMECMP)
-			// and reseting the Timer seems to be the only way to clear it
-            Timer::reset(); 
-		}
-    }
-
-    _int_vector[id](id);
+        _int_vector[id](id);
 
     if (id >= EXCS)
 	{
@@ -78,6 +104,77 @@ void IC::dispatch()
 	}
 }
 
+void IC::timer_dispatch()
+{
+    if (supervisor && !Timer::_sstc)
+	{
+		// we can't clear CPU::sipc(CPU::STI) in supervisor mode, 
+		// so let's ecall int_m2s to do it for us
+        CPU::ecall(); 
+	}
+    else
+	{
+		// MIP.MTI is a direct logic on (MTIME == MTIMECMP), and so is SIP.STI on (TIME >= STIMECMP) with Sstc,
+		// so reseting the Timer seems to be the only way to clear it
+        Timer::reset(); 
+	}
+
+    _int_vector[INT_SYS_TIMER](INT_SYS_TIMER);
+}
+
+void IC::soft_dispatch()
+{
+    if (supervisor)
+	{
+		// IPI EOI was already issued by _int_m2s, 
+		// so we only clear SSI
+        CPU::sipc(CPU::SSI); 
+	}
+    else
+        ipi_eoi(INT_RESCHEDULER);
+
+    // Take every IPI posted so far; later ones will raise the software interrupt again
+    Reg pending;
+    do
+        pending = _ipis[CPU::id()];
+    while (CPU::cas(_ipis[CPU::id()], pending, Reg(0)) != pending);
+
+    for (unsigned int i = 0; i < IPIS; i++)
+        if (pending & (1UL << (i + 1)))
+            _int_vector[SOFT_INT + i](SOFT_INT + i);
+
+    // A bare software interrupt (nothing posted) is treated as a reschedule request as before
+    if ((pending & 1) || !pending)
+        _int_vector[INT_RESCHEDULER](INT_RESCHEDULER);
+}
+
+// External interrupts are completed at the PLIC only after their handlers return, so a source never
+// preempts itself. When nested, the threshold is raised to the source's priority and interrupts are
+// reenabled meanwhile, so only higher-priority sources, the timer and IPIs get through. The handler
+// may then be preempted and resumed on another hart, so the threshold is restored and the source
+// completed on the context it was claimed from.
+void IC::plic_dispatch(Interrupt_Id id)
+{
+    unsigned int context = PLIC::context();
+    CPU::Reg32 irq = PLIC::take();
+
+    if (nested)
+    {
+        CPU::Reg32 threshold = PLIC::threshold();
+        PLIC::threshold(context, PLIC::priority(irq));
+        CPU::int_enable();
+
+        _int_vector[id](id);
+
+        CPU::int_disable();
+        PLIC::threshold(context, threshold);
+    }
+    else
+        _int_vector[id](id);
+
+    PLIC::complete(context, irq);
+}
+
 void IC::int_not(Interrupt_Id id)
 {
 	if (id == INT_RESCHEDULER) 
@@ -104,6 +201,13 @@ void IC::exception(Interrupt_Id id)
 		return;
 	}
 
+	if (((id == CPU::EXC_DRPF) || (id == CPU::EXC_DWPF)) && MMU::fault(tval, id == CPU::EXC_DWPF))
+	{ // first touch of a lazy page, which now has a zeroed frame:
+	  // return to the faulting instruction instead of skipping it
+		CPU::fr(0);
+		return;
+	}
+
 	db<IC, System>(WRN) << "IC::Exception(" << id << ") => {" << hex
 		<< "thread=" << thread << ",sp=" << sp
 		<< ",status=" << status << ",cause=" << cause
@@ -26,6 +26,10 @@ void IC::init()
 		{
             _int_vector[i] = &int_not;
 		}
+
+        // External interrupts start at the lowest priority (see priority())
+        for (unsigned int i = 0; i < PLIC::IRQS; i++)
+            _priority[i] = 1;
     }
     
 	// It is paramount that all cores wait for the bootstrap to initialize the interrupt vector,
@@ -10,6 +10,10 @@ void Machine::reboot()
     if(Traits<System>::reboot) {
         db<Machine>(TRC) << "Machine::reboot()" << endl;
 
+        // Interrupts might be off for good (e.g. on a panic), so buffered output is pushed out by polling
+        if(Traits<Serial_Display>::enabled)
+            Serial_Display::_engine.flush();
+
 #ifdef __sifive_e__
         CPU::Reg * reset = reinterpret_cast<CPU::Reg *>(Memory_Map::AON_BASE);
         reset[0] = 0x5555;
@@ -28,6 +32,9 @@ void Machine::poweroff()
 {
     db<Machine>(TRC) << "Machine::poweroff()" << endl;
 
+    if(Traits<Serial_Display>::enabled)
+        Serial_Display::_engine.flush();
+
 #ifdef __sifive_e__
         CPU::Reg * reset = reinterpret_cast<CPU::Reg *>(Memory_Map::AON_BASE);
         reset[0] = 0x5555;
@@ -6,7 +6,10 @@ __BEGIN_SYS
 
 void Machine::pre_init(System_Info *si)
 {
-    CPU::tvec(CPU::INT_DIRECT, &IC::entry);
+    if (Traits<IC>::vectored)
+        CPU::tvec(CPU::INT_INDEXED, &IC::vector);
+    else
+        CPU::tvec(CPU::INT_DIRECT, &IC::entry);
 
     if (CPU::is_bootstrap())
     {
@@ -26,6 +29,10 @@ void Machine::init()
 
     if (Traits<Timer>::enabled)
         Timer::init();
+
+    // Console output goes through the TX interrupt from now on
+    if (Traits<Serial_Display>::enabled && Traits<IC>::enabled && CPU::is_bootstrap())
+        Serial_Display::_engine.buffered(true);
 }
 
 __END_SYS
@@ -6,6 +6,7 @@
 __BEGIN_SYS
 
 Timer *Timer::_channels[CHANNELS];
+bool Timer::_sstc;
 
 void Timer::int_handler(Interrupt_Id i)
 {
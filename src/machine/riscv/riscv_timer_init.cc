@@ -21,6 +21,10 @@ void Timer::init()
 	// Important to be able to receive and handle interrupts correctly.
 	CPU::smp_barrier();
 
+    // Every hart probes its own Sstc, though they are expected to agree
+    _sstc = CPU::sstc();
+    db<Init, Timer>(INF) << "Timer::init:sstc=" << _sstc << endl;
+
     reset();
     IC::enable(IC::INT_SYS_TIMER);
 }
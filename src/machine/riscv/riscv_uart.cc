@@ -0,0 +1,62 @@
+// EPOS RISC-V UART Mediator Implementation
+
+// Only the parts SETUP can reach are here, since SETUP links the machine library
+// without the system library. The buffered input side, which blocks on a
+// Semaphore, is in src/api/uart.cc.
+
+#include <machine/uart.h>
+#include <machine/ic.h>
+
+__BEGIN_SYS
+
+// Class attributes
+UART * UART::_owner;
+volatile bool UART::_buffered;
+volatile bool UART::_locked;
+volatile unsigned int UART::_tx_head;
+volatile unsigned int UART::_tx_tail;
+char UART::_tx[TX_BUFFER_SIZE ? TX_BUFFER_SIZE : 1];
+volatile unsigned int UART::_rx_head;
+volatile unsigned int UART::_rx_tail;
+volatile unsigned long UART::_rx_overruns;
+char UART::_rx[RX_BUFFER_SIZE ? RX_BUFFER_SIZE : 1];
+
+// Methods
+void UART::flush()
+{
+    if(TX_BUFFER_SIZE) {
+        bool e = lock();
+        while(_tx_head != _tx_tail) {
+            while(!txd_ok());
+            txd(_tx[_tx_head]);
+            _tx_head = (_tx_head + 1) % TX_BUFFER_SIZE;
+        }
+        unlock(e);
+    }
+
+    Engine::flush();
+}
+
+void UART::enqueue(char c)
+{
+    bool e = lock();
+
+    if((_tx_head == _tx_tail) && txd_ok())
+        txd(c);
+    else {
+        unsigned int next = (_tx_tail + 1) % TX_BUFFER_SIZE;
+        if(next == _tx_head) {
+            // Full: make room by polling, so output is never lost, even with interrupts disabled
+            while(!txd_ok());
+            txd(_tx[_tx_head]);
+            _tx_head = (_tx_head + 1) % TX_BUFFER_SIZE;
+        }
+        _tx[_tx_tail] = c;
+        _tx_tail = next;
+        int_enable(false, true, false, false);
+    }
+
+    unlock(e);
+}
+
+__END_SYS
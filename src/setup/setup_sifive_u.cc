@@ -16,6 +16,7 @@ extern "C"
     // SETUP entry point is in .init (and not in .text), so it will be linked first and will be the first function after the ELF header in the image
     void _entry() __attribute__((used, naked, section(".init")));
     void _int_m2s() __attribute((naked, aligned(4)));
+    void _skip_trap() __attribute((naked, aligned(4)));
     void _setup();
 
 	// LD eliminates this variable while performing garbage collection, that's
@@ -225,6 +226,12 @@ void _entry() // machine mode
 	CLINT::mtimecmp(-1ULL); // configure MTIMECMP so it won't trigger a timer interrupt before we can setup_m2s()
 
 	if (Traits<Machine>::supervisor) {
+		// enable Sstc, if the hart has it, so supervisor mode can program
+		// its own timer through stimecmp; menvcfg is missing on harts older
+		// than the 1.12 privileged spec, so let _skip_trap step over it then
+		CPU::mtvec(CPU::INT_DIRECT, &_skip_trap);
+		CPU::menvcfgs(CPU::STCE);
+		bool sstc = CPU::menvcfg() & CPU::STCE;
 		// setup a machine mode interrupt handler
 		// to forward timer interrupts (which
 		// cannot be delegated via mideleg)
@@ -233,8 +240,9 @@ void _entry() // machine mode
 		CPU::mideleg( CPU::SSI | CPU::STI | CPU::SEI);
 		// delegate all exceptions to supervisor mode but ecalls
 		CPU::medeleg( 0xf1ff); 
-		// enable interrupt generation by at machine level
-		CPU::mie(CPU::MSI | CPU::MTI | CPU::MEI); 
+		// enable interrupt generation by at machine level (with Sstc, 
+		// MTI is never used and the timer needs no forwarding)
+		CPU::mie(sstc ? (CPU::MSI | CPU::MEI) : (CPU::MSI | CPU::MTI | CPU::MEI)); 
 		// before going into supervisor mode,
 		// prepare jump into supervisor mode at MRET with
 		// interrupts enabled at machine level
@@ -274,8 +282,18 @@ void _setup() // supervisor mode
     Setup setup;
 }
 
+// Machine-mode trap handler used only while probing for optional CSRs in _entry(): skips the (never compressed) CSR instruction that trapped
+void _skip_trap()
+{
+    ASM("       csrr     gp, mepc               \n"
+        "       addi     gp, gp, 4              \n"
+        "       csrw     mepc, gp               \n"
+        "       mret                            \n");
+}
+
 // RISC-V's CLINT triggers interrupt 7 (MTI) whenever MTIME == MTIMECMP and there is no way to instruct it to trigger interrupt 9 (STI). So, even if we delegate all interrupts with MIDELEG, MTI doesn't turn into STI and MTI is visible in SIP. In other words, MTI must always be handled in machine mode, although the OS will run in supervisor mode.
 // Therefore, an interrupt forwarder must be installed in machine mode to catch MTI and manually trigger STI. We use RAM_TOP for this, with the code at the beginning of the last page and per-core 256 bytes stacks at the end of the same page.
+// Harts with the Sstc extension skip all this: supervisor mode programs stimecmp itself and MTI stays disabled (see _entry() and Timer::config()).
 void _int_m2s()
 {
     // Save context
@@ -0,0 +1,269 @@
+// EPOS Buddy Allocator and Range Tree Test Program
+
+// SV39_MMU keeps its free frames in a Buddy_Allocator and the free part of each
+// application address range in a Range_Tree. Neither depends on paging, so both
+// are checked here on plain memory. Both use 100 units, which is not a power of
+// two, so the last units sit outside the largest block or subtree. Both are
+// taken to full exhaustion and back. Range_Tree is also checked against a
+// brute-force search after a long run of random reservations and releases.
+
+#include <utility/ostream.h>
+#include <utility/buddy.h>
+#include <utility/range_tree.h>
+
+using namespace EPOS;
+
+const unsigned long UNIT = 64;       // bytes (enough for a free block's header)
+const unsigned long UNITS = 100;     // not a power of two: 64 + 32 + 4
+const unsigned long BASE = 0x10000;  // so that no unit is at address 0, which means failure
+const unsigned int STEPS = 500;
+
+OStream cout;
+
+unsigned int errors;
+
+void check(bool ok, const char * what)
+{
+    if(!ok) {
+        cout << "FAIL " << what << endl;
+        errors++;
+    }
+}
+
+unsigned int seed = 1;
+unsigned int lcg(unsigned int max)
+{
+    seed = seed * 1103515245 + 12345; // the usual LCG is enough here
+    return (seed >> 16) % max;
+}
+
+
+// Buddy_Allocator
+char pool[UNITS * UNIT];
+
+struct Pool_Translation
+{
+    static void * log(unsigned long addr) { return &pool[addr - BASE]; }
+};
+
+typedef Buddy_Allocator<UNIT, BASE, UNITS * UNIT, Pool_Translation> Buddy;
+
+Buddy buddy;
+
+unsigned long addr(unsigned long unit) { return BASE + unit * UNIT; }
+
+// Everything is free again and merged back into the initial 64 + 32 + 4 blocks
+bool pristine()
+{
+    unsigned long units = 0;
+    for(unsigned int o = 0; o < Buddy::ORDERS; o++)
+        units += buddy.blocks(o) << o;
+    return (units == UNITS) && (buddy.available() == UNITS) && (buddy.largest() == 64)
+        && (buddy.blocks(6) == 1) && (buddy.blocks(5) == 1) && (buddy.blocks(2) == 1)
+        && (buddy.blocks(0) + buddy.blocks(1) + buddy.blocks(3) + buddy.blocks(4) == 0);
+}
+
+void test_buddy()
+{
+    cout << "Buddy_Allocator: " << UNITS << " units, " << Buddy::ORDERS << " orders" << endl;
+
+    check(!buddy.available() && !buddy.alloc(1), "a new buddy allocator is not empty");
+
+    buddy.free(addr(0), UNITS);
+    cout << "  initial:    " << buddy << endl;
+    check(pristine(), "freeing the whole region did not yield blocks of 64, 32 and 4 units");
+    check(!buddy.alloc(0) && !buddy.alloc(UNITS + 1), "alloc() accepted 0 or more units than the region");
+
+    // Full exhaustion, one unit at a time, then everything back in a scrambled order
+    static unsigned long single[UNITS];
+    static bool taken[UNITS];
+    unsigned long n = 0;
+    for(unsigned long a; (n < UNITS) && (a = buddy.alloc(1)); n++) {
+        single[n] = a;
+        unsigned long unit = (a - BASE) / UNIT;
+        check((a >= BASE) && !((a - BASE) % UNIT) && (unit < UNITS) && !taken[unit], "alloc(1) returned a unit out of the region or twice");
+        if(unit < UNITS)
+            taken[unit] = true;
+    }
+    check((n == UNITS) && !buddy.available() && !buddy.largest() && !buddy.alloc(1), "the region did not give exactly its units one at a time");
+    for(unsigned long i = 0; i < n; i++)
+        buddy.free(single[(i * 7) % n], 1); // 7 and 100 are coprime
+    cout << "  exhausted:  " << buddy << endl;
+    check(pristine(), "freeing single units did not merge them back");
+
+    // The largest blocks, down to the tail units past the last power of two
+    unsigned long a64 = buddy.alloc(64), a32 = buddy.alloc(32), a4 = buddy.alloc(4);
+    check((a64 == addr(0)) && (a32 == addr(64)) && (a4 == addr(96)), "the 64, 32 and 4 unit blocks are not where expected");
+    check(!buddy.alloc(1) && !buddy.available(), "units left after taking every block");
+    buddy.free(a4, 4);
+    check(buddy.alloc(4) == addr(96), "the tail block was not handed out again");
+    check(!buddy.alloc(1), "the tail block was handed out twice");
+    buddy.free(a64, 64);
+    buddy.free(a32, 32);
+    buddy.free(addr(96), 4);
+    check(pristine(), "freeing the largest blocks did not restore the region");
+
+    // Odd sizes take exactly what they ask for and give back the rest of the block
+    unsigned long sizes[] = {3, 5, 7, 33};
+    unsigned long odd[4];
+    unsigned long allocated = 0;
+    for(unsigned int i = 0; i < 4; i++) {
+        odd[i] = buddy.alloc(sizes[i]);
+        allocated += sizes[i];
+        check(odd[i] && (buddy.available() == UNITS - allocated), "an odd-sized allocation took more than it asked for");
+    }
+    check(buddy.largest() < 64, "a 64-unit block is still free after a 33-unit allocation");
+    check(!buddy.alloc(UNITS - allocated), "an allocation larger than any free block succeeded");
+    for(unsigned int i = 0; i < 4; i++)
+        for(unsigned int j = 0; j < 4; j++)
+            if((i != j) && (odd[i] < odd[j]))
+                check(odd[i] + sizes[i] * UNIT <= odd[j], "odd-sized allocations overlap");
+    check(buddy.claim(odd[0] + 3 * UNIT, 1), "the unit after a 3-unit allocation was not given back");
+    buddy.free(odd[0], 4);
+    for(unsigned int i = 1; i < 4; i++)
+        buddy.free(odd[i], sizes[i]);
+    cout << "  odd sizes:  " << buddy << endl;
+    check(pristine(), "freeing odd-sized allocations did not restore the region");
+
+    // A part of an allocation can be freed on its own
+    unsigned long a = buddy.alloc(16);
+    buddy.free(a + 8 * UNIT, 8);
+    check(buddy.available() == UNITS - 8, "freeing half of an allocation did not give back 8 units");
+    buddy.free(a, 8);
+    check(pristine(), "freeing both halves of an allocation did not merge them");
+
+    // Claims across blocks, of taken units and outside the region
+    check(buddy.claim(addr(10), 20), "claiming free units 10 to 29, across several blocks, failed");
+    check(buddy.available() == UNITS - 20, "a claim took more or less than it asked for");
+    check(!buddy.claim(addr(25), 10) && !buddy.claim(addr(29), 1), "units already claimed were claimed again");
+    check(buddy.available() == UNITS - 20, "a failed claim changed the free units");
+    check(buddy.claim(addr(30), 1) && buddy.claim(addr(9), 1), "the units around a claim are not free");
+    check(!buddy.claim(addr(98), 5) && !buddy.claim(BASE - UNIT, 1) && !buddy.claim(addr(0), 0), "a claim outside the region succeeded");
+    check(buddy.claim(addr(96), 4), "the tail units could not be claimed");
+    buddy.free(addr(9), 22);
+    buddy.free(addr(96), 4);
+    check(pristine(), "freeing claimed units did not restore the region");
+
+    // Growing in place, as Chunk::resize() does
+    a = buddy.alloc(8);
+    check(buddy.claim(a + 8 * UNIT, 8), "the units right after an allocation could not be claimed");
+    buddy.free(a, 16);
+    check(pristine(), "freeing a grown allocation did not restore the region");
+
+    cout << "  fragmentation with 1 unit taken from each 4-unit run: ";
+    for(unsigned long u = 0; u < UNITS; u += 4)
+        buddy.claim(addr(u), 1);
+    cout << buddy.fragmentation() << "%" << endl;
+    check((buddy.largest() == 2) && (buddy.fragmentation() == 100 - 2 * 100 / buddy.available()), "fragmentation is not reported as expected");
+    for(unsigned long u = 0; u < UNITS; u += 4)
+        buddy.free(addr(u), 1);
+    check(pristine(), "freeing scattered units did not restore the region");
+}
+
+
+// Range_Tree
+typedef Range_Tree<UNITS> Ranges;
+
+Ranges ranges;
+bool used[UNITS];
+
+unsigned long brute_search(unsigned long n)
+{
+    for(unsigned long start = 0, run = 0; start + run < UNITS; )
+        if(used[start + run]) {
+            start += run + 1;
+            run = 0;
+        } else if(++run == n)
+            return start;
+    return Ranges::NONE;
+}
+
+unsigned long brute_largest()
+{
+    unsigned long largest = 0;
+    for(unsigned long i = 0, run = 0; i < UNITS; i++) {
+        run = used[i] ? 0 : run + 1;
+        if(run > largest)
+            largest = run;
+    }
+    return largest;
+}
+
+bool brute_free(unsigned long start, unsigned long n)
+{
+    if(!n || (start >= UNITS) || (n > UNITS - start))
+        return false;
+    for(unsigned long i = start; i < start + n; i++)
+        if(used[i])
+            return false;
+    return true;
+}
+
+void test_range_tree()
+{
+    cout << "Range_Tree: " << UNITS << " units, " << Ranges::LEAVES << " leaves" << endl;
+
+    check((ranges.largest() == UNITS) && (ranges.search(UNITS) == 0), "a new range tree is not entirely free");
+    check((ranges.search(UNITS + 1) == Ranges::NONE) && (ranges.search(0) == Ranges::NONE), "search() found a run of 0 or more units than the tree");
+    check(ranges.free(0, UNITS) && !ranges.free(99, 2) && !ranges.free(UNITS, 1) && !ranges.free(0, 0), "free() looked past the last unit");
+
+    // Full exhaustion and back
+    check((ranges.alloc(10) == 0) && (ranges.alloc(10) == 10) && (ranges.alloc(80) == 20), "alloc() did not take the lowest runs");
+    check((ranges.alloc(1) == Ranges::NONE) && !ranges.largest(), "units left after taking the whole tree");
+    ranges.release(10, 10);
+    check((ranges.search(10) == 10) && (ranges.search(11) == Ranges::NONE), "a released run is not found, or found larger");
+    ranges.release(95, 5);
+    check(ranges.search(5) == 10, "search() did not return the lowest run");
+    ranges.reserve(10, 10);
+    check((ranges.search(5) == 95) && (ranges.search(6) == Ranges::NONE), "the tail units are not found, or found larger");
+    check((ranges.alloc(5) == 95) && !ranges.free(95, 5), "the tail units were not taken");
+    ranges.release(0, UNITS);
+    check((ranges.largest() == UNITS) && ranges.free(0, UNITS), "releasing everything did not free the whole tree");
+
+    // Every other unit reserved, then runs joined in the middle
+    for(unsigned long i = 0; i < UNITS; i += 2)
+        ranges.reserve(i, 1);
+    check((ranges.largest() == 1) && (ranges.search(1) == 1) && (ranges.search(2) == Ranges::NONE), "alternating units are not seen as single free units");
+    ranges.release(50, 1);
+    check((ranges.search(2) == 49) && (ranges.search(3) == 49) && (ranges.search(4) == Ranges::NONE), "joining runs across the middle of the tree failed");
+    ranges.release(0, UNITS);
+
+    // Random reservations and releases, checked against a brute-force search
+    unsigned int mismatches = 0;
+    for(unsigned int step = 0; step < STEPS; step++) {
+        unsigned long start = lcg(UNITS);
+        unsigned long n = 1 + lcg(UNITS - start);
+        bool reserve = lcg(3); // mostly reservations, so the tree fills up
+        if(reserve)
+            ranges.reserve(start, n);
+        else
+            ranges.release(start, n);
+        for(unsigned long i = start; i < start + n; i++)
+            used[i] = reserve;
+
+        unsigned long want = 1 + lcg(16);
+        if(ranges.search(want) != brute_search(want))
+            mismatches++;
+        unsigned long s = lcg(UNITS), m = lcg(8);
+        if(ranges.free(s, m) != brute_free(s, m))
+            mismatches++;
+        if(ranges.largest() != brute_largest())
+            mismatches++;
+    }
+    cout << "  " << STEPS << " random steps: " << mismatches << " mismatches" << endl;
+    check(!mismatches, "the range tree disagrees with a brute-force search");
+}
+
+
+int main()
+{
+    cout << "Buddy Allocator and Range Tree test" << endl;
+
+    test_buddy();
+    test_range_tree();
+
+    if(!errors)
+        cout << "PASS" << endl;
+
+    return 0;
+}
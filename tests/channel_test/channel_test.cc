@@ -0,0 +1,150 @@
+// EPOS Shared-Memory Channel Test Program
+
+// Moves buffers back and forth between this program's Address_Space and a
+// second one. Only the running Address_Space is mapped, so buffers are written
+// and read there, and the other side checks that each buffer it gets is backed
+// by the same frames the sender filled, i.e., nothing was copied. First the
+// other side receives and releases, and the data must still be there when a
+// buffer comes back. Then it sends, and the buffers must arrive here usable.
+
+#include <memory.h>
+#include <channel.h>
+
+using namespace EPOS;
+
+const unsigned int BUFFERS = 4;
+const unsigned int ROUNDS = 3 * BUFFERS; // every buffer goes around several times
+const unsigned long BUFFER_SIZE = 8192;  // bytes (more than one page)
+
+typedef Channel<BUFFERS> Test_Channel;
+typedef CPU::Log_Addr Log_Addr;
+typedef CPU::Phy_Addr Phy_Addr;
+
+OStream cout;
+
+Address_Space * self;
+Address_Space * other;
+Test_Channel * to_other;
+Test_Channel * from_other;
+
+volatile unsigned int errors;
+Phy_Addr sent[ROUNDS];   // frames of each buffer as the sender saw them
+unsigned long length[ROUNDS];
+
+void fail(const char * what, unsigned int round)
+{
+    cout << "FAIL " << what << " (round " << round << ")" << endl;
+    errors++;
+}
+
+void fill(Log_Addr buffer, unsigned int round)
+{
+    unsigned int * data = buffer;
+    for(unsigned int i = 0; i < BUFFER_SIZE / sizeof(unsigned int); i++)
+        data[i] = round * 100000 + i;
+}
+
+bool filled(Log_Addr buffer, unsigned int round)
+{
+    unsigned int * data = buffer;
+    for(unsigned int i = 0; i < BUFFER_SIZE / sizeof(unsigned int); i++)
+        if(data[i] != round * 100000 + i)
+            return false;
+    return true;
+}
+
+// The other side, receiving from us and giving the buffers back
+int receiver()
+{
+    for(unsigned int r = 0; r < ROUNDS; r++) {
+        unsigned long n;
+        Log_Addr buffer = to_other->receive(&n);
+        if(!buffer || (other->physical(buffer) != sent[r]))
+            fail("a received buffer is not backed by the frames the sender filled", r);
+        if(n != length[r])
+            fail("a received buffer has the wrong length", r);
+        if(!to_other->release(buffer))
+            fail("release() failed", r);
+    }
+    return 0;
+}
+
+// The other side, sending to us
+int sender()
+{
+    for(unsigned int r = 0; r < ROUNDS; r++) {
+        Log_Addr buffer = from_other->acquire();
+        sent[r] = other->physical(buffer);
+        if(!from_other->send(buffer, BUFFER_SIZE))
+            fail("send() failed", r);
+    }
+    return 0;
+}
+
+int main()
+{
+    cout << "Channel test" << endl;
+
+    if(Traits<Build>::MODEL == Traits<Build>::SiFive_E) {
+        cout << "This test requires multiheap and the SiFive-E doesn't have enough memory to run it!" << endl;
+        cout << "PASS" << endl;
+        return 0;
+    }
+
+    self = new (SYSTEM) Address_Space(MMU::current());
+    other = new (SYSTEM) Address_Space;
+
+    // From here to there: the data must survive the trip there and back
+    to_other = new (SYSTEM) Test_Channel(BUFFER_SIZE, self, other);
+    cout << "Sending " << ROUNDS << " buffers of " << to_other->buffer_size() << " bytes to another address space" << endl;
+    Log_Addr last[BUFFERS];
+    Thread * peer = new Thread(&receiver);
+    for(unsigned int r = 0; r < ROUNDS; r++) {
+        Log_Addr buffer = to_other->acquire();
+        if((r >= BUFFERS) && !filled(buffer, r - BUFFERS))
+            fail("a buffer came back with different data", r);
+        fill(buffer, r);
+        last[r % BUFFERS] = buffer;
+        sent[r] = self->physical(buffer);
+        length[r] = BUFFER_SIZE - r;
+        if(!to_other->send(buffer, length[r]))
+            fail("send() failed", r);
+    }
+    peer->join();
+    delete peer;
+    for(unsigned int r = ROUNDS; r < ROUNDS + BUFFERS; r++)
+        if(!filled(to_other->acquire(), r - BUFFERS))
+            fail("a buffer came back with different data", r);
+    if(to_other->send(Log_Addr(&length[0]), 1) || to_other->release(last[0]))
+        fail("send() or release() took a buffer that is not the caller's", ROUNDS);
+    delete to_other;
+
+    // From there to here: buffers must arrive on the frames the sender had
+    from_other = new (SYSTEM) Test_Channel(BUFFER_SIZE, other, self);
+    cout << "Receiving " << ROUNDS << " buffers from another address space" << endl;
+    peer = new Thread(&sender);
+    for(unsigned int r = 0; r < ROUNDS; r++) {
+        unsigned long n;
+        Log_Addr buffer = from_other->receive(&n);
+        if(!buffer || (self->physical(buffer) != sent[r]))
+            fail("a received buffer is not backed by the frames the sender had", r);
+        if(n != BUFFER_SIZE)
+            fail("a received buffer has the wrong length", r);
+        fill(buffer, r);
+        if(!filled(buffer, r))
+            fail("a received buffer cannot be written", r);
+        if(!from_other->release(buffer))
+            fail("release() failed", r);
+    }
+    peer->join();
+    delete peer;
+    delete from_other;
+
+    delete other;
+
+    cout << "Errors: " << errors << endl;
+    if(!errors)
+        cout << "PASS" << endl;
+
+    return 0;
+}
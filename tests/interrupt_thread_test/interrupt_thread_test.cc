@@ -0,0 +1,74 @@
+// EPOS Interrupt_Thread Test Program
+
+// Raises the UART's TX watermark interrupt several times and checks that each
+// one reaches the handler of an Interrupt_Thread. The top half masks the source
+// before the IC acknowledges it, so a source that stays masked, or whose
+// acknowledgement is lost, stops delivering after the first interrupt.
+
+#include <time.h>
+#include <interrupt.h>
+#include <machine/uart.h>
+
+using namespace EPOS;
+
+const unsigned int ROUNDS = 3;
+const unsigned int WAIT = 100000; // us
+
+OStream cout;
+
+#ifdef __riscv__
+
+UART uart;
+volatile unsigned int handled;
+
+void handler(IC::Interrupt_Id id)
+{
+    // The TX watermark stays up while the FIFO is empty, so the device itself must be quiesced
+    uart.int_disable(false, true, false, false);
+    handled++;
+}
+
+int main()
+{
+    cout << "Interrupt_Thread test" << endl;
+
+    uart.buffered(false); // the console driver must let go of the UART interrupt
+
+    bool ok = true;
+    {
+        Interrupt_Thread thread(IC::INT_UART0, &handler);
+
+        for(unsigned int i = 0; i < ROUNDS; i++) {
+            uart.int_enable(false, true, false, false);
+            Alarm::delay(WAIT);
+            cout << "Round " << i << ": " << handled << " interrupt(s) handled" << endl;
+            if(handled != i + 1) {
+                ok = false;
+                break;
+            }
+        }
+
+        uart.int_disable(false, true, false, false);
+    }
+
+    if(ok)
+        cout << "PASS" << endl;
+    else
+        cout << "FAIL interrupt " << handled + 1 << " was not delivered" << endl;
+
+    uart.buffered(true);
+
+    return 0;
+}
+
+#else
+
+int main()
+{
+    cout << "Interrupt_Thread test: skipped, it relies on the RISC-V UART" << endl;
+    cout << "PASS" << endl;
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,213 @@
+// EPOS Interrupt and Scheduling Latency Benchmark
+
+// Each benchmark collects SAMPLES intervals measured with TSC::time_stamp(),
+// which on RISC-V reads the CLINT's mtime, shared by all harts, so intervals
+// that start on one hart and end on another are still meaningful. Results are
+// printed as one "METRIC <benchmark>.<statistic> <value> ns" line per statistic
+// (min, avg, p99 and max), followed by "PASS" once every benchmark completes.
+
+#include <time.h>
+#include <real-time.h>
+#include <synchronizer.h>
+
+using namespace EPOS;
+
+const unsigned int SAMPLES = 200;
+const unsigned int WARMUP = 10;
+const unsigned int ALARM_PERIOD = 50000;  // us (a multiple of the tick)
+const unsigned int ALARM_SAMPLES = 40;
+const unsigned int IRQ_PERIOD = 10000;    // us (one tick)
+const unsigned int REMOTE_CPU = 1;        // hart the cross-hart wakeup thread is pinned to
+
+typedef TSC::Time_Stamp Time_Stamp;
+
+OStream cout;
+
+class Samples
+{
+public:
+    Samples(): _n(0) {}
+
+    void reset() { _n = 0; }
+
+    void add(Time_Stamp ticks) {
+        if(_n < SAMPLES)
+            _ticks[_n++] = ticks;
+    }
+
+    void report(const char * name) {
+        if(!_n) {
+            cout << "FAIL " << name << ": no samples" << endl;
+            return;
+        }
+
+        // Insertion sort is fine for a few hundred samples
+        for(unsigned int i = 1; i < _n; i++) {
+            Time_Stamp v = _ticks[i];
+            unsigned int j = i;
+            for(; j && (_ticks[j - 1] > v); j--)
+                _ticks[j] = _ticks[j - 1];
+            _ticks[j] = v;
+        }
+
+        Time_Stamp sum = 0;
+        for(unsigned int i = 0; i < _n; i++)
+            sum += _ticks[i];
+
+        metric(name, "min", _ticks[0]);
+        metric(name, "avg", sum / _n);
+        metric(name, "p99", _ticks[(_n * 99 - 1) / 100]);
+        metric(name, "max", _ticks[_n - 1]);
+    }
+
+private:
+    static void metric(const char * name, const char * statistic, Time_Stamp ticks) {
+        cout << "METRIC " << name << "." << statistic << " " << ns(ticks) << " ns" << endl;
+    }
+
+    static unsigned long long ns(Time_Stamp ticks) { return ticks * 1000000000ULL / TSC::frequency(); }
+
+private:
+    unsigned int _n;
+    Time_Stamp _ticks[SAMPLES];
+};
+
+volatile Time_Stamp stamp;
+Semaphore ping(0);
+Semaphore pong(0);
+Samples samples;
+
+// Yield: time from a thread calling Thread::yield() to the other ready thread running
+int yielder(int id)
+{
+    for(unsigned int i = 0; i < SAMPLES + WARMUP; i++) {
+        if(stamp && (i >= WARMUP))
+            samples.add(TSC::time_stamp() - stamp);
+        stamp = TSC::time_stamp();
+        Thread::yield();
+    }
+    stamp = 0;
+    return 0;
+}
+
+// Context switch: time from a thread blocking on a Semaphore, right after waking up
+// its peer on the same hart, to the peer running (i.e. v() + p() + dispatch)
+int switch_ping()
+{
+    for(unsigned int i = 0; i < SAMPLES + WARMUP; i++) {
+        stamp = TSC::time_stamp();
+        pong.v();
+        ping.p();
+    }
+    return 0;
+}
+
+int switch_pong()
+{
+    for(unsigned int i = 0; i < SAMPLES + WARMUP; i++) {
+        pong.p();
+        if(i >= WARMUP)
+            samples.add(TSC::time_stamp() - stamp);
+        ping.v();
+    }
+    return 0;
+}
+
+// Wakeup to run across harts: time from v() on this hart to the thread sleeping on another hart running
+int remote_sleeper()
+{
+    for(unsigned int i = 0; i < SAMPLES + WARMUP; i++) {
+        ping.p();
+        if(i >= WARMUP)
+            samples.add(TSC::time_stamp() - stamp);
+        pong.v();
+    }
+    return 0;
+}
+
+// Alarm jitter: deviation of the interval between consecutive jobs of a periodic thread from its period
+int periodic()
+{
+    Time_Stamp period = Time_Stamp(ALARM_PERIOD) * TSC::frequency() / 1000000;
+    Time_Stamp last = 0;
+    while(Periodic_Thread::wait_next()) {
+        Time_Stamp now = TSC::time_stamp();
+        if(last)
+            samples.add((now - last > period) ? now - last - period : period - (now - last));
+        last = now;
+    }
+    return 0;
+}
+
+// IRQ to thread: time from an alarm handler, running in the timer interrupt, releasing a Semaphore to the thread waiting on it running
+void irq_handler()
+{
+    stamp = TSC::time_stamp();
+    ping.v();
+}
+
+int irq_waiter()
+{
+    for(unsigned int i = 0; i < SAMPLES + WARMUP; i++) {
+        ping.p();
+        if(i >= WARMUP)
+            samples.add(TSC::time_stamp() - stamp);
+    }
+    return 0;
+}
+
+int main()
+{
+    cout << "Interrupt and Scheduling Latency Benchmark" << endl;
+    cout << "CPUS=" << CPU::cores() << ", TSC=" << TSC::frequency() << " Hz, samples=" << SAMPLES << endl;
+
+    {
+        Thread a(&yielder, 0);
+        Thread b(&yielder, 1);
+        a.join();
+        b.join();
+        samples.report("yield");
+    }
+
+    samples.reset();
+    {
+        Thread a(&switch_ping);
+        Thread b(&switch_pong);
+        a.join();
+        b.join();
+        samples.report("context_switch");
+    }
+
+    if(CPU::cores() > REMOTE_CPU) {
+        samples.reset();
+        Thread sleeper(Thread::Configuration(Thread::READY, Thread::Criterion(ALARM_PERIOD, ALARM_PERIOD, 0, REMOTE_CPU)), &remote_sleeper);
+        for(unsigned int i = 0; i < SAMPLES + WARMUP; i++) {
+            stamp = TSC::time_stamp();
+            ping.v();
+            pong.p();
+        }
+        sleeper.join();
+        samples.report("remote_wakeup");
+    } else
+        cout << "remote_wakeup: skipped, a single hart" << endl;
+
+    samples.reset();
+    {
+        Periodic_Thread thread(Periodic_Thread::Configuration(ALARM_PERIOD, ALARM_PERIOD, Periodic_Thread::UNKNOWN, Periodic_Thread::NOW, ALARM_SAMPLES + 1), &periodic);
+        thread.join();
+        samples.report("alarm_jitter");
+    }
+
+    samples.reset();
+    {
+        Thread waiter(&irq_waiter);
+        Function_Handler handler(&irq_handler);
+        Alarm alarm(IRQ_PERIOD, &handler, SAMPLES + WARMUP);
+        waiter.join();
+        samples.report("irq_to_thread");
+    }
+
+    cout << "PASS" << endl;
+
+    return 0;
+}
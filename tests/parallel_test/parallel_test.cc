@@ -0,0 +1,98 @@
+// EPOS Fork_Join_Pool Test Program
+
+// Runs parallel loops on a Fork_Join_Pool, some of them issued at the same time
+// by several threads, and checks that every iteration runs exactly once and
+// that each loop has finished when parallel_for() returns.
+
+#include <parallel.h>
+
+using namespace EPOS;
+
+const unsigned int ITERATIONS = 1000;
+const unsigned int CALLERS = 3;
+const unsigned int ROUNDS = 5;
+const unsigned int PERIOD = 1000000; // us (threads pinned to a hart need a real-time criterion)
+
+OStream cout;
+
+Fork_Join_Pool * pool;
+
+// Counts how many times each iteration ran
+class Counter
+{
+public:
+    Counter() { reset(); }
+
+    void reset() {
+        for(unsigned int i = 0; i < ITERATIONS; i++)
+            _hits[i] = 0;
+    }
+
+    void operator()(long i) { CPU::finc(_hits[i]); }
+
+    // Number of iterations that did not run exactly once
+    unsigned int errors() const {
+        unsigned int e = 0;
+        for(unsigned int i = 0; i < ITERATIONS; i++)
+            if(_hits[i] != 1)
+                e++;
+        return e;
+    }
+
+private:
+    volatile unsigned long _hits[ITERATIONS];
+};
+
+Counter counter[CALLERS + 1];
+volatile unsigned int errors;
+
+int caller(unsigned int id)
+{
+    for(unsigned int r = 0; r < ROUNDS; r++) {
+        counter[id].reset();
+        pool->parallel_for(0, ITERATIONS, 1 + r * 7, counter[id]);
+        unsigned int e = counter[id].errors();
+        if(e) {
+            cout << "FAIL caller " << id << ", round " << r << ": " << e << " iterations did not run exactly once" << endl;
+            CPU::finc(errors);
+        }
+    }
+    return 0;
+}
+
+int main()
+{
+    cout << "Fork_Join_Pool test" << endl;
+
+    pool = new Fork_Join_Pool(Thread::Criterion(PERIOD, PERIOD, 0));
+    cout << "Workers: " << pool->workers() << endl;
+
+    // One caller, with grains from single iterations to more than the whole loop
+    long grains[] = {1, 3, 64, ITERATIONS, 2 * ITERATIONS};
+    for(unsigned int g = 0; g < sizeof(grains) / sizeof(long); g++) {
+        counter[0].reset();
+        pool->parallel_for(0, ITERATIONS, grains[g], counter[0]);
+        unsigned int e = counter[0].errors();
+        cout << "grain=" << grains[g] << ": " << e << " errors" << endl;
+        if(e) {
+            cout << "FAIL grain " << grains[g] << ": " << e << " iterations did not run exactly once" << endl;
+            errors++;
+        }
+    }
+
+    // Several callers dealing chunks into the same deques at the same time
+    Thread * thread[CALLERS];
+    for(unsigned int i = 0; i < CALLERS; i++)
+        thread[i] = new Thread(Thread::Configuration(Thread::READY, Thread::Criterion(PERIOD, PERIOD, 0, i % CPU::cores())), &caller, i + 1);
+    for(unsigned int i = 0; i < CALLERS; i++) {
+        thread[i]->join();
+        delete thread[i];
+    }
+
+    delete pool;
+
+    if(!errors)
+        cout << "PASS" << endl;
+
+    return 0;
+}
@@ -0,0 +1,256 @@
+// EPOS Lock-free Ring Test Program
+
+// Checks SPSC_Ring, MPMC_Ring and Blocking_Ring. First, each ring is filled
+// and drained several times on a single thread to check the full and empty
+// conditions and the order of the items across index wrap-arounds. Then
+// producers and consumers pinned to different harts pass numbered items
+// through each ring. Every item must arrive exactly once. Through the
+// SPSC_Ring, items must arrive in order. Through the MPMC rings, each
+// consumer must see each producer's items in order.
+
+#include <synchronizer.h>
+#include <utility/ring.h>
+
+using namespace EPOS;
+
+const unsigned int ITEMS = 5000;     // per producer
+const unsigned int PRODUCERS = 2;
+const unsigned int CONSUMERS = 2;
+const unsigned int TOTAL = PRODUCERS * ITEMS;
+const unsigned int PERIOD = 1000000; // us (threads pinned to a hart need a real-time criterion)
+
+typedef SPSC_Ring<unsigned long, 8> SPSC;
+typedef MPMC_Ring<unsigned long, 8> MPMC;
+typedef Blocking_Ring<MPMC_Ring<unsigned long, 4>> Blocking; // small, so both sides block often
+
+OStream cout;
+
+unsigned int errors;
+
+void fail(const char * ring, const char * what)
+{
+    cout << "FAIL " << ring << ": " << what << endl;
+    errors++;
+}
+
+// Items carry their producer in the upper bits and their number in the lower ones
+unsigned long item(unsigned int producer, unsigned int n) { return (static_cast<unsigned long>(producer) << 24) | n; }
+unsigned int producer_of(unsigned long i) { return i >> 24; }
+unsigned int number_of(unsigned long i) { return i & ((1UL << 24) - 1); }
+
+// Fills and drains a ring a few times, so its indices go around it
+template<typename Ring>
+void fill_and_drain(Ring & ring, const char * name)
+{
+    unsigned long o;
+    unsigned long next = 0;
+    for(unsigned int round = 0; round < 5; round++) {
+        if(!ring.empty() || ring.full() || ring.size() || ring.remove(&o))
+            fail(name, "an empty ring is not seen as empty");
+        for(unsigned long i = 0; i < Ring::CAPACITY; i++)
+            if(!ring.insert(next + i))
+                fail(name, "insert() failed before the ring was full");
+        if(!ring.full() || ring.empty() || (ring.size() != Ring::CAPACITY) || ring.insert(0))
+            fail(name, "a full ring is not seen as full");
+        for(unsigned long i = 0; i < Ring::CAPACITY; i++)
+            if(!ring.remove(&o) || (o != next + i))
+                fail(name, "items did not come out in the order they went in");
+        next += Ring::CAPACITY;
+
+        // Half full, so the next round starts in the middle of the ring
+        if(round == 2) {
+            for(unsigned long i = 0; i < Ring::CAPACITY / 2 + 1; i++)
+                ring.insert(next + i);
+            for(unsigned long i = 0; i < Ring::CAPACITY / 2 + 1; i++)
+                if(!ring.remove(&o) || (o != next + i))
+                    fail(name, "items did not come out in the order they went in");
+            next += Ring::CAPACITY / 2 + 1;
+        }
+    }
+}
+
+// Exactly-once and per-producer order bookkeeping shared by the concurrent tests
+volatile unsigned long hits[TOTAL];
+volatile unsigned long claimed;
+volatile unsigned int disorders;
+
+void reset()
+{
+    for(unsigned int i = 0; i < TOTAL; i++)
+        hits[i] = 0;
+    claimed = 0;
+    disorders = 0;
+}
+
+void forget(long * last)
+{
+    for(unsigned int p = 0; p < PRODUCERS; p++)
+        last[p] = -1;
+}
+
+// Records item i as received by a consumer that last saw last[p] from each producer p
+void record(unsigned long i, long * last)
+{
+    unsigned int p = producer_of(i);
+    unsigned int n = number_of(i);
+    if((p >= PRODUCERS) || (n >= ITEMS)) {
+        CPU::finc(disorders);
+        return;
+    }
+    if(static_cast<long>(n) <= last[p])
+        CPU::finc(disorders);
+    last[p] = n;
+    CPU::finc(hits[p * ITEMS + n]);
+}
+
+void check(const char * name)
+{
+    unsigned int lost = 0, repeated = 0;
+    for(unsigned int i = 0; i < TOTAL; i++)
+        if(!hits[i])
+            lost++;
+        else if(hits[i] > 1)
+            repeated++;
+    cout << name << ": " << lost << " lost, " << repeated << " repeated, " << disorders << " out of order" << endl;
+    if(lost || repeated)
+        fail(name, "items were lost or received more than once");
+    if(disorders)
+        fail(name, "items were received out of order");
+}
+
+Thread * pinned(int (* entry)(unsigned int), unsigned int id, unsigned int cpu)
+{
+    return new Thread(Thread::Configuration(Thread::READY, Thread::Criterion(PERIOD, PERIOD, 0, cpu % CPU::cores())), entry, id);
+}
+
+
+// SPSC_Ring: one producer, one consumer, on different harts
+SPSC spsc;
+
+int spsc_producer(unsigned int id)
+{
+    for(unsigned int n = 0; n < ITEMS; n++)
+        while(!spsc.insert(item(id, n)))
+            Thread::yield();
+    return 0;
+}
+
+int spsc_consumer(unsigned int id)
+{
+    long last[PRODUCERS];
+    forget(last);
+    unsigned long o;
+    for(unsigned int n = 0; n < ITEMS; n++) {
+        while(!spsc.remove(&o))
+            Thread::yield();
+        if(o != item(0, n)) // a single producer, so nothing may be skipped either
+            CPU::finc(disorders);
+        else
+            record(o, last);
+    }
+    return 0;
+}
+
+
+// MPMC_Ring: several of each, spinning when full or empty
+MPMC mpmc;
+
+int mpmc_producer(unsigned int id)
+{
+    for(unsigned int n = 0; n < ITEMS; n++)
+        while(!mpmc.insert(item(id, n)))
+            Thread::yield();
+    return 0;
+}
+
+int mpmc_consumer(unsigned int id)
+{
+    long last[PRODUCERS];
+    forget(last);
+    unsigned long o;
+    while(CPU::finc(claimed) < TOTAL) { // each ticket stands for one item still to come
+        while(!mpmc.remove(&o))
+            Thread::yield();
+        record(o, last);
+    }
+    return 0;
+}
+
+
+// Blocking_Ring: several of each, sleeping when full or empty
+Blocking blocking;
+
+int blocking_producer(unsigned int id)
+{
+    for(unsigned int n = 0; n < ITEMS; n++)
+        blocking.insert(item(id, n));
+    return 0;
+}
+
+int blocking_consumer(unsigned int id)
+{
+    long last[PRODUCERS];
+    forget(last);
+    while(CPU::finc(claimed) < TOTAL)
+        record(blocking.remove(), last);
+    return 0;
+}
+
+
+void run(int (* producer)(unsigned int), unsigned int producers, int (* consumer)(unsigned int), unsigned int consumers)
+{
+    Thread * thread[PRODUCERS + CONSUMERS];
+    unsigned int n = 0;
+
+    reset();
+    for(unsigned int i = 0; i < consumers; i++, n++) // consumers first, so they start on empty rings
+        thread[n] = pinned(consumer, i, 1 + n);
+    for(unsigned int i = 0; i < producers; i++, n++)
+        thread[n] = pinned(producer, i, 1 + n);
+    for(unsigned int i = 0; i < n; i++) {
+        thread[i]->join();
+        delete thread[i];
+    }
+}
+
+int main()
+{
+    cout << "Lock-free Ring test" << endl;
+    cout << "CPUS=" << CPU::cores() << endl;
+
+    fill_and_drain(spsc, "SPSC_Ring");
+    fill_and_drain(mpmc, "MPMC_Ring");
+
+    // Blocking_Ring's non-blocking side
+    unsigned long o;
+    for(unsigned int i = 0; i < 4; i++)
+        if(!blocking.try_insert(i))
+            fail("Blocking_Ring", "try_insert() failed before the ring was full");
+    if(!blocking.full() || blocking.try_insert(4))
+        fail("Blocking_Ring", "a full ring is not seen as full");
+    for(unsigned int i = 0; i < 4; i++)
+        if(!blocking.try_remove(&o) || (o != i))
+            fail("Blocking_Ring", "items did not come out in the order they went in");
+    if(!blocking.empty() || blocking.try_remove(&o))
+        fail("Blocking_Ring", "an empty ring is not seen as empty");
+
+    run(&spsc_producer, 1, &spsc_consumer, 1);
+    for(unsigned int i = 1; i < PRODUCERS; i++) // only producer 0 ran
+        for(unsigned int n = 0; n < ITEMS; n++)
+            hits[i * ITEMS + n] = 1;
+    check("SPSC_Ring");
+
+    run(&mpmc_producer, PRODUCERS, &mpmc_consumer, CONSUMERS);
+    check("MPMC_Ring");
+
+    run(&blocking_producer, PRODUCERS, &blocking_consumer, CONSUMERS);
+    check("Blocking_Ring");
+
+    if(!spsc.empty() || !mpmc.empty() || !blocking.empty())
+        fail("rings", "items were left behind");
+
+    if(!errors)
+        cout << "PASS" << endl;
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+// EPOS RW_Lock Test Program
+
+// First, several readers and a writer take the lock over and over, yielding
+// inside their critical sections, while counters of who is inside check that
+// the writer is always alone. Then a writer is made to wait behind a reader,
+// and a reader arriving after it must not get in before the writer is served.
+
+#include <time.h>
+#include <synchronizer.h>
+
+using namespace EPOS;
+
+const unsigned int READERS = 4;
+const unsigned int ITERATIONS = 50;
+const unsigned int WAIT = 100000; // us
+
+OStream cout;
+
+RW_Lock lock;
+volatile long readers_in;
+volatile long writers_in;
+volatile long max_readers_in;
+volatile unsigned int violations;
+volatile unsigned int sequence;
+
+int reader(unsigned int id)
+{
+    for(unsigned int i = 0; i < ITERATIONS; i++) {
+        lock.read_lock();
+        long n = CPU::finc(readers_in) + 1;
+        if(n > max_readers_in)
+            max_readers_in = n;
+        if(writers_in)
+            violations++;
+        Thread::yield();
+        if(writers_in)
+            violations++;
+        CPU::fdec(readers_in);
+        lock.read_unlock();
+        Thread::yield();
+    }
+    return 0;
+}
+
+int writer(unsigned int id)
+{
+    for(unsigned int i = 0; i < ITERATIONS; i++) {
+        lock.write_lock();
+        if(CPU::finc(writers_in) || readers_in)
+            violations++;
+        Thread::yield();
+        if(readers_in || (writers_in != 1))
+            violations++;
+        CPU::fdec(writers_in);
+        lock.write_unlock();
+        Thread::yield();
+    }
+    return 0;
+}
+
+volatile unsigned int writer_turn;
+volatile unsigned int reader_turn;
+
+int late_writer()
+{
+    lock.write_lock();
+    writer_turn = ++sequence;
+    Alarm::delay(WAIT); // the late reader must keep waiting meanwhile
+    lock.write_unlock();
+    return 0;
+}
+
+int late_reader()
+{
+    lock.read_lock();
+    reader_turn = ++sequence;
+    lock.read_unlock();
+    return 0;
+}
+
+int main()
+{
+    cout << "RW_Lock test" << endl;
+
+    Thread * thread[READERS + 1];
+    for(unsigned int i = 0; i < READERS; i++)
+        thread[i] = new Thread(&reader, i);
+    thread[READERS] = new Thread(&writer, 0U);
+    for(unsigned int i = 0; i <= READERS; i++) {
+        thread[i]->join();
+        delete thread[i];
+    }
+    cout << "Mutual exclusion: " << violations << " violations, up to " << max_readers_in << " readers at once" << endl;
+    if(violations)
+        cout << "FAIL a writer shared the lock " << violations << " times" << endl;
+
+    // Writer preference
+    bool preferred = true;
+    lock.read_lock();
+    Thread * w = new Thread(&late_writer);
+    Alarm::delay(WAIT); // the writer is now waiting for us
+    Thread * r = new Thread(&late_reader);
+    Alarm::delay(WAIT);
+    if(reader_turn) {
+        cout << "FAIL a reader got in while a writer was waiting" << endl;
+        preferred = false;
+    }
+    lock.read_unlock();
+    w->join();
+    r->join();
+    delete w;
+    delete r;
+    cout << "Writer preference: writer went " << writer_turn << ", reader went " << reader_turn << endl;
+    if(preferred && (writer_turn != 1 || reader_turn != 2)) {
+        cout << "FAIL the waiting writer was not served before the later reader" << endl;
+        preferred = false;
+    }
+
+    if(!violations && preferred)
+        cout << "PASS" << endl;
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+// EPOS Synchronizer and Allocator Throughput Benchmark
+
+// Each benchmark runs a fixed number of operations and times them with
+// TSC::time_stamp(). Results are printed as "METRIC <benchmark> <value> ops/s"
+// lines, followed by "PASS" once every benchmark completes, so runs can be
+// compared by a script on the host. A contended Mutex that loses increments or
+// a segment that cannot be attached prints "FAIL" instead, so that a broken
+// run does not pass on its rates alone.
+
+#include <memory.h>
+#include <time.h>
+#include <synchronizer.h>
+
+using namespace EPOS;
+
+const unsigned int BATCH = 64;           // blocks held at once by the heap benchmarks
+const unsigned int OPERATIONS = 160 * BATCH; // a multiple of BATCH, so the heap benchmarks do exactly this many
+const unsigned int SEGMENT_SIZE = 16384; // bytes
+const unsigned int SEGMENTS = 200;
+const unsigned int ALARMS = 2000;
+const unsigned int PERIOD = 1000000;     // us (threads pinned to a hart need a real-time criterion)
+
+typedef TSC::Time_Stamp Time_Stamp;
+
+OStream cout;
+
+Time_Stamp start;
+bool failed;
+
+void begin() { start = TSC::time_stamp(); }
+
+void end(const char * name, unsigned long operations)
+{
+    Time_Stamp ticks = TSC::time_stamp() - start;
+    if(!ticks)
+        ticks = 1;
+    cout << "METRIC " << name << " " << Time_Stamp(operations) * TSC::frequency() / ticks << " ops/s" << endl;
+}
+
+// Mutex: lock/unlock pairs, alone on a hart or with one thread per hart hammering the same Mutex
+Mutex mutex;
+volatile unsigned long counter;
+
+int locker(unsigned int n)
+{
+    for(unsigned int i = 0; i < n; i++) {
+        mutex.lock();
+        counter++;
+        mutex.unlock();
+    }
+    return 0;
+}
+
+// Semaphore: round trips between two threads on the same hart
+Semaphore ping(0);
+Semaphore pong(0);
+
+int ponger()
+{
+    for(unsigned int i = 0; i < OPERATIONS; i++) {
+        ping.p();
+        pong.v();
+    }
+    return 0;
+}
+
+// Heap: alloc/free pairs, keeping BATCH blocks at a time, for a few size distributions
+unsigned int fixed_size(unsigned int i, unsigned int size) { return size; }
+
+unsigned int mixed_size(unsigned int i, unsigned int max)
+{
+    static unsigned int seed = 1;
+    seed = seed * 1103515245 + 12345; // the usual LCG is enough to spread sizes
+    return 8 + (seed >> 16) % max;
+}
+
+void heap(const char * name, unsigned int (* size)(unsigned int, unsigned int), unsigned int param)
+{
+    char * block[BATCH];
+
+    begin();
+    for(unsigned int done = 0; done < OPERATIONS; done += BATCH) {
+        for(unsigned int i = 0; i < BATCH; i++)
+            block[i] = new char[size(i, param)];
+        for(unsigned int i = 0; i < BATCH; i++)
+            delete[] block[(i * 7) % BATCH]; // not in allocation order (7 and BATCH are coprime)
+    }
+    end(name, OPERATIONS);
+}
+
+void nop() {}
+
+int main()
+{
+    cout << "Synchronizer and Allocator Throughput Benchmark" << endl;
+    cout << "CPUS=" << CPU::cores() << ", TSC=" << TSC::frequency() << " Hz" << endl;
+
+    begin();
+    locker(OPERATIONS);
+    end("mutex.uncontended", OPERATIONS);
+
+    if(CPU::cores() > 1) {
+        Thread * thread[Traits<Build>::CPUS];
+        begin();
+        for(unsigned int cpu = 0; cpu < CPU::cores(); cpu++)
+            thread[cpu] = new Thread(Thread::Configuration(Thread::READY, Thread::Criterion(PERIOD, PERIOD, 0, cpu)), &locker, OPERATIONS);
+        for(unsigned int cpu = 0; cpu < CPU::cores(); cpu++)
+            thread[cpu]->join();
+        end("mutex.contended", OPERATIONS * CPU::cores());
+        for(unsigned int cpu = 0; cpu < CPU::cores(); cpu++)
+            delete thread[cpu];
+        if(counter != OPERATIONS * (CPU::cores() + 1)) {
+            cout << "FAIL mutex.contended: " << counter << " increments instead of " << OPERATIONS * (CPU::cores() + 1) << endl;
+            failed = true;
+        }
+    } else
+        cout << "mutex.contended: skipped, a single hart" << endl;
+
+    {
+        Thread peer(&ponger);
+        begin();
+        for(unsigned int i = 0; i < OPERATIONS; i++) {
+            ping.v();
+            pong.p();
+        }
+        end("semaphore.pingpong", OPERATIONS);
+        peer.join();
+    }
+
+    heap("heap.small", &fixed_size, 16);
+    heap("heap.page", &fixed_size, 4096);
+    heap("heap.mixed", &mixed_size, 2048);
+
+    if(Traits<Build>::MODEL != Traits<Build>::SiFive_E) {
+        Address_Space self(MMU::current());
+        Segment * segment[SEGMENTS];
+        CPU::Log_Addr address[SEGMENTS];
+
+        begin();
+        for(unsigned int i = 0; i < SEGMENTS; i++)
+            segment[i] = new (SYSTEM) Segment(SEGMENT_SIZE, MMU::Flags::SYSD);
+        end("segment.create", SEGMENTS);
+
+        begin();
+        for(unsigned int i = 0; i < SEGMENTS; i++)
+            address[i] = self.attach(segment[i]);
+        end("segment.attach", SEGMENTS);
+
+        unsigned int unattached = 0;
+        for(unsigned int i = 0; i < SEGMENTS; i++)
+            if(!address[i])
+                unattached++;
+        if(unattached) {
+            cout << "FAIL segment.attach: " << unattached << " of " << SEGMENTS << " segments could not be attached" << endl;
+            failed = true;
+        }
+
+        begin();
+        for(unsigned int i = 0; i < SEGMENTS; i++)
+            if(address[i])
+                self.detach(segment[i], address[i]);
+        end("segment.detach", SEGMENTS);
+
+        begin();
+        for(unsigned int i = 0; i < SEGMENTS; i++)
+            delete segment[i];
+        end("segment.destroy", SEGMENTS);
+    } else
+        cout << "segment: skipped, the SiFive-E has no MMU" << endl;
+
+    {
+        Function_Handler handler(&nop);
+        begin();
+        for(unsigned int i = 0; i < ALARMS; i++) {
+            Alarm alarm(PERIOD, &handler); // destroying an armed alarm cancels it
+        }
+        end("alarm.create_cancel", ALARMS);
+    }
+
+    if(!failed)
+        cout << "PASS" << endl;
+
+    return 0;
+}